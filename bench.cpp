@@ -0,0 +1,371 @@
+#include "collision.h"
+#include "drone_batch.h"
+#include "drone_kernels.h"
+#include "drone_manager.h"
+#include "drone_index.h"
+#include "particle_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+micro benchmarks for the simulation hot path. every case is fed from a
+seeded mt19937 so numbers are comparable between runs and machines
+
+usage: game7_bench [--sizes 1000,10000,...] [--budget-ms n] [--seed n]
+                   [--threads n]
+*/
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+// the query radii drone_manager::tick uses
+constexpr float query_radii[] = { 60, 70, 100, 200, 400 };
+// spawn area of drone_manager's constructor
+constexpr int world_extent = 1920;
+// kernel results land here so the calls are not optimized away
+volatile float sink;
+
+struct bench_options
+{
+    std::vector<int> sizes{ 1000, 10000, 100000, 1000000 };
+    std::chrono::milliseconds budget{ 500 };
+    std::uint32_t seed{ 7 };
+    // 0 uses every hardware thread
+    unsigned threads{ 0 };
+};
+
+struct bench_result
+{
+    std::uint64_t iterations{ 0 };
+    double mean_ns{ 0 };
+    double min_ns{ 0 };
+};
+
+/*
+runs fn until the time budget is used up (at least once) and reports the
+per-call timings
+*/
+template<typename F>
+bench_result
+measure(std::chrono::milliseconds budget, F&& fn)
+{
+    bench_result r;
+    r.min_ns = 1e300;
+    double total = 0;
+    auto deadline = clock::now() + budget;
+    do {
+        auto start = clock::now();
+        fn();
+        double ns = std::chrono::duration<double, std::nano>(clock::now() -
+                                                             start)
+                      .count();
+        total += ns;
+        r.min_ns = std::min(r.min_ns, ns);
+        r.iterations++;
+    } while (clock::now() < deadline);
+    r.mean_ns = total / r.iterations;
+    return r;
+}
+
+void
+report(const std::string& name, int n, const bench_result& r)
+{
+    std::cout << std::left << std::setw(28) << name << std::right
+              << std::setw(9) << n << std::setw(10) << r.iterations
+              << std::setw(16) << std::fixed << std::setprecision(1)
+              << r.mean_ns / 1000 << std::setw(16) << r.min_ns / 1000
+              << "\n";
+}
+
+std::vector<drone>
+random_drones(int n, std::mt19937& gen)
+{
+    auto d = std::uniform_real_distribution<float>{ 0, world_extent };
+    std::vector<drone> drones(n);
+    for (auto& g : drones) {
+        g.pos = { d(gen), d(gen) };
+        g.health = 1;
+    }
+    return drones;
+}
+
+const char*
+broadphase_name(broadphase kind)
+{
+    return kind == broadphase::grid ? "grid" : "quadtree";
+}
+
+void
+bench_index(broadphase kind, int n, const bench_options& opts)
+{
+    auto gen = std::mt19937{ opts.seed };
+    auto drones = random_drones(n, gen);
+    drone_index index(kind, 100);
+    std::string label = broadphase_name(kind);
+
+    report(label + " build", n, measure(opts.budget, [&] {
+               index.build(drones);
+           }));
+
+    index.build(drones);
+    auto d = std::uniform_real_distribution<float>{ 0, world_extent };
+    std::vector<std::uint32_t> res;
+    for (float r : query_radii) {
+        // a fixed batch of query centers per radius, timed per query
+        constexpr int batch = 256;
+        std::vector<Vector2> centers(batch);
+        for (auto& c : centers) {
+            c = { d(gen), d(gen) };
+        }
+        std::size_t hits = 0;
+        auto result = measure(opts.budget, [&] {
+            for (auto const& c : centers) {
+                res.clear();
+                index.query(c.x - r, c.y - r, r * 2, r * 2, res);
+                hits += res.size();
+            }
+        });
+        result.mean_ns /= batch;
+        result.min_ns /= batch;
+        std::ostringstream name;
+        name << label << " query r=" << r;
+        report(name.str(), n, result);
+        std::cout << "    " << hits / (result.iterations * batch)
+                  << " candidates/query\n";
+
+        auto visited = measure(opts.budget, [&] {
+            for (auto const& c : centers) {
+                index.query(c.x - r, c.y - r, r * 2, r * 2, [&](auto e) {
+                    hits += drones[e].health;
+                });
+            }
+        });
+        visited.mean_ns /= batch;
+        visited.min_ns /= batch;
+        name.str("");
+        name << label << " visit r=" << r;
+        report(name.str(), n, visited);
+    }
+}
+
+/*
+the rule force kernel at every simd level the cpu supports, summing a whole
+species (as rule(a, b) does) and a gathered candidate list (as the quadtree
+rule does)
+*/
+void
+bench_kernels(int n, const bench_options& opts)
+{
+    auto gen = std::mt19937{ opts.seed };
+    auto drones = random_drones(n, gen);
+    drone_store store;
+    store.pack(drones);
+    std::vector<std::uint32_t> idx(n);
+    for (int i = 0; i < n; i++) {
+        idx[i] = i;
+    }
+    std::shuffle(idx.begin(), idx.end(), gen);
+    Vector2 p{ world_extent / 2.f, world_extent / 2.f };
+
+    auto detected = detect_simd_level();
+    for (int l = 0; l <= int(detected); l++) {
+        set_simd_level(simd_level(l));
+        auto contiguous = measure(opts.budget, [&] {
+            sink = accumulate_force(p.x, p.y, store, nullptr, n, 0.3, 200).x;
+        });
+        auto gathered = measure(opts.budget, [&] {
+            sink =
+              accumulate_force(p.x, p.y, store, idx.data(), n, 0.3, 200).x;
+        });
+        std::string name = std::string("rule kernel ") +
+                           simd_level_name(simd_level(l));
+        report(name, n, contiguous);
+        report(name + " gather", n, gathered);
+    }
+    set_simd_level(detected);
+}
+
+void
+bench_tick(broadphase kind, float theta, int n, const bench_options& opts)
+{
+    auto gen = std::mt19937{ opts.seed };
+    drone_manager dm{ n, gen, opts.threads };
+    dm.use_broadphase(kind);
+    dm.use_barnes_hut(theta);
+    Vector2 player_pos{ 1920.f / 2 + 20.f, 1080.f / 2 + 50.f };
+    std::ostringstream name;
+    name << "tick " << broadphase_name(kind);
+    if (theta > 0) {
+        name << " theta=" << theta;
+    }
+    report(name.str(), n, measure(opts.budget, [&] { dm.tick(player_pos); }));
+}
+
+/*
+one frame of bullet collision with a full magazine in flight: two turrets
+firing every 10 ms for the 5 s a bullet lives
+*/
+void
+bench_collision(int n, const bench_options& opts)
+{
+    constexpr int bullets = 1000;
+    auto gen = std::mt19937{ opts.seed };
+    drone_manager dm{ n, gen, opts.threads };
+    auto d = std::uniform_real_distribution<float>{ 0, world_extent };
+    auto angle = std::uniform_real_distribution<float>{ 0, 2 * PI };
+    // one step of a bullet at its usual 15 units per frame
+    std::vector<Vector2> from(bullets);
+    std::vector<Vector2> to(bullets);
+    for (int b = 0; b < bullets; b++) {
+        float a = angle(gen);
+        from[b] = { d(gen), d(gen) };
+        to[b] = { from[b].x + 15 * std::cos(a), from[b].y + 15 * std::sin(a) };
+    }
+    collision_stage stage;
+    std::size_t hits = 0;
+    auto result = measure(opts.budget, [&] {
+        hits += stage.collide(from, to, 4, dm).size();
+    });
+    report("collide 1000 bullets", n, result);
+    std::cout << "    " << hits / result.iterations << " hits/frame\n";
+}
+
+/*
+a frame of effects in a pool kept full: every particle expired this frame is
+replaced by a fresh one, as in a long fight
+*/
+void
+bench_particles(int n, const bench_options& opts)
+{
+    constexpr std::uint32_t lifetime = 24;
+    particle_pool pool(n);
+    auto gen = std::mt19937{ opts.seed };
+    auto d = std::uniform_real_distribution<float>{ 0, world_extent };
+    auto ticks = std::uniform_int_distribution<std::uint32_t>{ 1, lifetime };
+    while (pool.spawn({ d(gen), d(gen) }, { 1, 0 }, ticks(gen))) {
+    }
+    auto result = measure(opts.budget, [&] {
+        pool.advance();
+        pool.expire();
+        while (pool.spawn({ d(gen), d(gen) }, { 1, 0 }, lifetime)) {
+        }
+    });
+    report("particles advance+expire", n, result);
+}
+
+/*
+building the render batches of the whole swarm, as drone_manager::render
+does, at the window's zoom and zoomed out far enough to show everything as
+points
+*/
+void
+bench_batch(int n, const bench_options& opts)
+{
+    auto gen = std::mt19937{ opts.seed };
+    drone_manager dm{ n, gen, opts.threads };
+    dm.tick({ 1920.f / 2 + 20.f, 1080.f / 2 + 50.f });
+    thread_pool& pool = dm.workers();
+    for (float zoom : { 1.f, 0.1f }) {
+        Camera2D camera{};
+        camera.zoom = zoom;
+        camera.offset = { 1920.f / 2, 1080.f / 2 };
+        camera.target = { 1920.f / 2 + 20.f, 1080.f / 2 + 50.f };
+        view v{ camera, { 1920, 1080 } };
+        drone_batch batch;
+        auto result = measure(opts.budget, [&] {
+            build_batch(batch,
+                        dm.drones(species::green).values(),
+                        dm.index_for(species::green),
+                        drone_radius(species::green),
+                        GREEN,
+                        v,
+                        pool);
+        });
+        std::ostringstream name;
+        name << "batch zoom=" << zoom;
+        report(name.str(), n, result);
+        std::cout << "    " << batch.size() << " drawn, "
+                  << batch.vertices.size() << " vertices\n";
+    }
+}
+
+std::vector<int>
+parse_sizes(const char* arg)
+{
+    std::vector<int> sizes;
+    std::istringstream in(arg);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        sizes.emplace_back(std::atoi(item.c_str()));
+    }
+    return sizes;
+}
+
+bool
+parse_options(int argc, char** argv, bench_options& opts)
+{
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        if (std::strcmp(argv[i], "--sizes") == 0) {
+            opts.sizes = parse_sizes(argv[++i]);
+        } else if (std::strcmp(argv[i], "--budget-ms") == 0) {
+            opts.budget = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            opts.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seed") == 0) {
+            opts.seed = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+};
+
+int
+main(int argc, char** argv)
+{
+    bench_options opts;
+    if (!parse_options(argc, argv, opts)) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--sizes 1000,10000,...] [--budget-ms n] [--seed n]"
+                     " [--threads n]\n";
+        return 1;
+    }
+
+    std::cout << std::left << std::setw(28) << "case" << std::right
+              << std::setw(9) << "n" << std::setw(10) << "iters"
+              << std::setw(16) << "mean (us)" << std::setw(16) << "min (us)"
+              << "\n";
+    for (int n : opts.sizes) {
+        std::cout << "-- " << n << " drones, "
+                  << n * 100.0 * 100 / (world_extent * world_extent)
+                  << " per 100x100\n";
+        for (auto kind : { broadphase::quadtree, broadphase::grid }) {
+            bench_index(kind, n, opts);
+        }
+        bench_kernels(n, opts);
+        for (auto kind : { broadphase::quadtree, broadphase::grid }) {
+            bench_tick(kind, 0, n, opts);
+        }
+        for (float theta : { 0.5f, 1.f }) {
+            bench_tick(broadphase::quadtree, theta, n, opts);
+        }
+        bench_collision(n, opts);
+        bench_particles(n, opts);
+        bench_batch(n, opts);
+    }
+    return 0;
+}
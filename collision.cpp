@@ -0,0 +1,107 @@
+#include "collision.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <raymath.h>
+
+collision_stage::collision_stage(float cell_size)
+  : cell_size(cell_size)
+{
+}
+
+void
+collision_stage::collide_cell(std::span<const Vector2> from,
+                              std::span<const Vector2> to,
+                              std::uint32_t first,
+                              std::uint32_t last,
+                              float bullet_radius,
+                              drone_manager& dm)
+{
+    // everything the paths of the cell's bullets cover
+    Vector2 lo = from[bins[first].bullet];
+    Vector2 hi = lo;
+    for (auto k = first; k < last; k++) {
+        for (auto p : { from[bins[k].bullet], to[bins[k].bullet] }) {
+            lo = { std::min(lo.x, p.x), std::min(lo.y, p.y) };
+            hi = { std::max(hi.x, p.x), std::max(hi.y, p.y) };
+        }
+    }
+    for (auto s : { species::green, species::red, species::yellow }) {
+        auto const& drones = dm.drones(s);
+        float reach = bullet_radius + drone_radius(s);
+        auto visit = [&](std::uint32_t i) {
+            auto p = drones[i].pos;
+            for (auto k = first; k < last; k++) {
+                auto b = bins[k].bullet;
+                float t;
+                if (yhl_util::sweep_circle(
+                      from[b], to[b], p, reach, yhl_util::out(t)) &&
+                    t < closest[b].time) {
+                    closest[b] = candidate{ t, s, i };
+                }
+            }
+        };
+        dm.index_for(s).query(lo.x - reach,
+                              lo.y - reach,
+                              hi.x - lo.x + reach * 2,
+                              hi.y - lo.y + reach * 2,
+                              visit);
+    }
+}
+
+const std::vector<bullet_hit>&
+collision_stage::collide(std::span<const Vector2> from,
+                         std::span<const Vector2> to,
+                         float bullet_radius,
+                         drone_manager& dm)
+{
+    GAME7_ZONE("collide");
+    hits.clear();
+    // bullets are binned by the middle of their path
+    bins.resize(from.size());
+    for (std::uint32_t b = 0; b < from.size(); b++) {
+        auto mid = Vector2Lerp(from[b], to[b], 0.5f);
+        auto cx = std::int32_t(std::floor(mid.x / cell_size));
+        auto cy = std::int32_t(std::floor(mid.y / cell_size));
+        bins[b] = binned{
+            (std::uint64_t(std::uint32_t(cx)) << 32) | std::uint32_t(cy), b
+        };
+    }
+    std::sort(bins.begin(), bins.end(), [](auto const& l, auto const& r) {
+        return l.cell < r.cell;
+    });
+    for (auto s : { species::green, species::red, species::yellow }) {
+        if (!dm.index_for(s).in_sync(dm.drones(s).size())) {
+            dm.index_for(s).build(dm.drones(s));
+        }
+    }
+    cells.clear();
+    for (std::uint32_t k = 0; k < bins.size(); k++) {
+        if (k == 0 || bins[k].cell != bins[k - 1].cell) {
+            cells.emplace_back(k);
+        }
+    }
+    cells.emplace_back(std::uint32_t(bins.size()));
+    closest.assign(from.size(),
+                   candidate{ std::numeric_limits<float>::infinity() });
+
+    // a cell owns its bullets, so the cells can run in parallel
+    dm.workers().parallel_for(
+      cells.size() - 1, 16, [&](std::size_t begin, std::size_t end) {
+          for (auto c = begin; c < end; c++) {
+              collide_cell(
+                from, to, cells[c], cells[c + 1], bullet_radius, dm);
+          }
+      });
+
+    for (std::uint32_t b = 0; b < closest.size(); b++) {
+        auto const& c = closest[b];
+        if (std::isfinite(c.time)) {
+            auto drone = dm.drones(c.kind).handle_at(c.drone);
+            auto at = Vector2Lerp(from[b], to[b], c.time);
+            hits.emplace_back(bullet_hit{ b, c.kind, drone, c.time, at });
+        }
+    }
+    return hits;
+}
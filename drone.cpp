@@ -0,0 +1,39 @@
+#include "drone.h"
+
+void
+drone_store::resize(std::size_t n)
+{
+    x.resize(n);
+    y.resize(n);
+    vx.resize(n);
+    vy.resize(n);
+    mass.resize(n);
+    health.resize(n);
+}
+
+void
+drone_store::pack(std::span<const drone> drones)
+{
+    resize(drones.size());
+    for (std::size_t i = 0; i < drones.size(); i++) {
+        auto const& d = drones[i];
+        x[i] = d.pos.x;
+        y[i] = d.pos.y;
+        vx[i] = d.vel.x;
+        vy[i] = d.vel.y;
+        mass[i] = d.mass;
+        health[i] = d.health;
+    }
+}
+
+void
+drone_store::unpack(std::span<drone> drones) const
+{
+    for (std::size_t i = 0; i < drones.size(); i++) {
+        auto& d = drones[i];
+        d.pos = { x[i], y[i] };
+        d.vel = { vx[i], vy[i] };
+        d.mass = mass[i];
+        d.health = health[i];
+    }
+}
@@ -0,0 +1,154 @@
+#include "drone_batch.h"
+#include "profiler.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <raymath.h>
+#include <rlgl.h>
+
+namespace {
+// longest edge of a circle's outline, in pixels
+constexpr float segment_pixels = 4;
+constexpr std::uint32_t min_segments = 6;
+constexpr std::uint32_t max_segments = 36;
+// vertices handed to rlgl between batch limit checks, whole triangles
+constexpr std::size_t submit_chunk = 3 * 2048;
+};
+
+Rectangle
+view::bounds() const
+{
+    std::array<Vector2, 4> corners{
+        GetScreenToWorld2D({ 0, 0 }, camera),
+        GetScreenToWorld2D({ screen.x, 0 }, camera),
+        GetScreenToWorld2D({ 0, screen.y }, camera),
+        GetScreenToWorld2D(screen, camera),
+    };
+    Vector2 lo = corners[0];
+    Vector2 hi = corners[0];
+    for (auto c : corners) {
+        lo = { std::min(lo.x, c.x), std::min(lo.y, c.y) };
+        hi = { std::max(hi.x, c.x), std::max(hi.y, c.y) };
+    }
+    return { lo.x, lo.y, hi.x - lo.x, hi.y - lo.y };
+}
+
+void
+cull(std::vector<std::uint32_t>& visible,
+     std::span<const drone> drones,
+     const drone_index& index,
+     float r,
+     const view& v)
+{
+    GAME7_ZONE("cull");
+    visible.clear();
+    auto b = v.bounds();
+    b = { b.x - r, b.y - r, b.width + 2 * r, b.height + 2 * r };
+    auto on_screen = [&](std::uint32_t i) {
+        auto p = drones[i].pos;
+        if (p.x >= b.x && p.x <= b.x + b.width && p.y >= b.y &&
+            p.y <= b.y + b.height) {
+            visible.emplace_back(i);
+        }
+    };
+    if (index.in_sync(drones.size()) &&
+        index.query_beats_scan(b.width, b.height, drones.size())) {
+        index.query(b.x, b.y, b.width, b.height, on_screen);
+    } else {
+        for (std::uint32_t i = 0; i < drones.size(); i++) {
+            on_screen(i);
+        }
+    }
+}
+
+void
+fill_batch(drone_batch& out,
+           float r,
+           Color color,
+           float zoom,
+           thread_pool& pool)
+{
+    GAME7_ZONE("fill batch");
+    out.color = color;
+    float screen_r = r * zoom;
+    out.points = 2 * screen_r < 1;
+    std::uint32_t segments = 0;
+    if (out.points) {
+        out.triangles = 2;
+    } else {
+        auto outline = 2 * PI * screen_r;
+        segments = std::uint32_t(std::ceil(outline / segment_pixels));
+        segments = std::clamp(segments, min_segments, max_segments);
+        out.triangles = segments;
+    }
+    auto per = out.vertices_per_drone();
+    out.vertices.resize(out.size() * per);
+
+    // the outline once, every drone offsets it
+    std::array<Vector2, max_segments + 1> rim;
+    for (std::uint32_t k = 0; segments > 0 && k <= segments; k++) {
+        float a = 2 * PI * k / segments;
+        rim[k] = { std::cos(a) * r, std::sin(a) * r };
+    }
+    // a square one pixel across
+    float h = 0.5f / zoom;
+
+    pool.parallel_for(
+      out.size(), 1024, [&](std::size_t begin, std::size_t end) {
+          for (auto k = begin; k < end; k++) {
+              auto c = out.centers[k];
+              auto* vtx = out.vertices.data() + k * per;
+              if (out.points) {
+                  // corners in the order DrawRectangle winds them
+                  Vector2 tl{ c.x - h, c.y - h }, bl{ c.x - h, c.y + h };
+                  Vector2 br{ c.x + h, c.y + h }, tr{ c.x + h, c.y - h };
+                  for (auto q : { tl, bl, br, tl, br, tr }) {
+                      *vtx++ = q;
+                  }
+                  continue;
+              }
+              // a fan wound like DrawCircleSector: center, next, current
+              for (std::uint32_t s = 0; s < segments; s++) {
+                  vtx[3 * s] = c;
+                  vtx[3 * s + 1] = c + rim[s + 1];
+                  vtx[3 * s + 2] = c + rim[s];
+              }
+          }
+      });
+}
+
+void
+build_batch(drone_batch& out,
+            std::span<const drone> drones,
+            const drone_index& index,
+            float r,
+            Color color,
+            const view& v,
+            thread_pool& pool)
+{
+    GAME7_ZONE("build batch");
+    cull(out.visible, drones, index, r, v);
+    out.centers.resize(out.visible.size());
+    for (std::size_t k = 0; k < out.visible.size(); k++) {
+        out.centers[k] = drones[out.visible[k]].pos;
+    }
+    fill_batch(out, r, color, v.camera.zoom, pool);
+}
+
+void
+drone_batch::draw() const
+{
+    GAME7_ZONE("draw batch");
+    for (std::size_t first = 0; first < vertices.size();
+         first += submit_chunk) {
+        auto n = std::min(submit_chunk, vertices.size() - first);
+        // flushes the batch rlgl has collected if these wouldn't fit
+        rlCheckRenderBatchLimit(int(n));
+        rlBegin(RL_TRIANGLES);
+        rlColor4ub(color.r, color.g, color.b, color.a);
+        for (auto i = first; i < first + n; i++) {
+            rlVertex2f(vertices[i].x, vertices[i].y);
+        }
+        rlEnd();
+    }
+}
@@ -0,0 +1,125 @@
+#include "drone_index.h"
+#include "profiler.h"
+#include <algorithm>
+
+drone_index::drone_index(broadphase kind, float cell_size)
+  : kind(kind)
+  , qtree(-1000, -1000, 4920, 4080)
+  , grid(cell_size)
+  , built_kind(kind)
+{
+}
+
+void
+drone_index::build(std::span<const drone> drones)
+{
+    GAME7_ZONE("index build");
+    built_kind = kind;
+    indexed = drones.size();
+    stale = false;
+    unsummarized = false;
+    if (kind == broadphase::grid) {
+        qtree.clear();
+        grid.build(drones);
+        return;
+    }
+    grid.clear();
+    if (drones.empty()) {
+        qtree.clear();
+        return;
+    }
+    // the tree covers the bounding square of the drones with some slack,
+    // so it stays balanced wherever the swarm wanders and update() can
+    // keep it for a while
+    Vector2 lo = drones.front().pos;
+    Vector2 hi = lo;
+    for (auto const& d : drones) {
+        lo = { std::min(lo.x, d.pos.x), std::min(lo.y, d.pos.y) };
+        hi = { std::max(hi.x, d.pos.x), std::max(hi.y, d.pos.y) };
+    }
+    float side = std::max({ hi.x - lo.x, hi.y - lo.y, 1.f });
+    float slack = side / 8;
+    qtree.clear(lo.x - slack, lo.y - slack, side + 2 * slack, side + 2 * slack);
+    qtree.rebuild(drones);
+    qtree.summarize(drones);
+}
+
+void
+drone_index::update(std::span<const drone> drones)
+{
+    GAME7_ZONE("index update");
+    if (kind == broadphase::grid || !in_sync(drones.size())) {
+        build(drones);
+        return;
+    }
+    for (auto const& d : drones) {
+        if (d.pos.x < qtree.x || d.pos.x > qtree.x + qtree.w ||
+            d.pos.y < qtree.y || d.pos.y > qtree.y + qtree.h) {
+            build(drones);
+            return;
+        }
+    }
+    for (std::size_t i = 0; i < drones.size(); i++) {
+        qtree.move(std::uint32_t(i), drones[i].pos.x, drones[i].pos.y);
+    }
+    qtree.summarize(drones);
+    unsummarized = false;
+}
+
+void
+drone_index::swap_remove(std::uint32_t i, std::uint32_t last)
+{
+    // the grid cannot follow, it waits for a rebuild
+    if (!stale && built_kind == broadphase::quadtree) {
+        qtree.swap_remove(i, last);
+        indexed--;
+        unsummarized = true;
+    } else {
+        stale = true;
+    }
+}
+
+void
+drone_index::refresh(std::span<const drone> drones)
+{
+    if (!in_sync(drones.size())) {
+        build(drones);
+    } else if (unsummarized) {
+        qtree.summarize(drones);
+        unsummarized = false;
+    }
+}
+
+void
+drone_index::query(float x,
+                   float y,
+                   float w,
+                   float h,
+                   std::vector<std::uint32_t>& res,
+                   bool debug) const
+{
+    if (built_kind == broadphase::grid) {
+        grid.query(x, y, w, h, res, debug);
+    } else {
+        qtree.query(x, y, w, h, res, debug);
+    }
+}
+
+const std::vector<std::uint32_t>&
+drone_index::query(float x, float y, float w, float h) const
+{
+    if (built_kind == broadphase::grid) {
+        return grid.query(x, y, w, h);
+    }
+    return qtree.query(x, y, w, h);
+}
+
+void
+drone_index::draw() const
+{
+    if (built_kind == broadphase::grid) {
+        grid.draw();
+    } else {
+        qtree.draw();
+    }
+}
@@ -0,0 +1,473 @@
+#include "drone_kernels.h"
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GAME7_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct kernel_set
+{
+    void (*force)(float px,
+                  float py,
+                  const float* bx,
+                  const float* by,
+                  const float* bm,
+                  const std::uint32_t* idx,
+                  std::size_t n,
+                  const force_term* terms,
+                  std::size_t m,
+                  Vector2* out);
+    void (*player)(float* x,
+                   float* y,
+                   float* vx,
+                   float* vy,
+                   std::size_t n,
+                   float px,
+                   float py,
+                   float f);
+};
+
+// scalar kernels, also used for the tails of the vector loops. the force
+// kernels add to out
+void
+force_scalar(float px,
+             float py,
+             const float* bx,
+             const float* by,
+             const float* bm,
+             const std::uint32_t* idx,
+             std::size_t n,
+             const force_term* terms,
+             std::size_t m,
+             Vector2* out)
+{
+    for (std::size_t i = 0; i < n; i++) {
+        auto j = idx ? idx[i] : i;
+        float dx = px - bx[j];
+        float dy = py - by[j];
+        float dist = std::sqrt(dx * dx + dy * dy);
+        if (!(dist > 0)) {
+            continue;
+        }
+        for (std::size_t t = 0; t < m; t++) {
+            if (dist < terms[t].effective_dist) {
+                float F = bm[j] * 0.5 * terms[t].f / dist;
+                out[t].x += F * dx;
+                out[t].y += F * dy;
+            }
+        }
+    }
+}
+
+void
+player_scalar(float* x,
+              float* y,
+              float* vx,
+              float* vy,
+              std::size_t n,
+              float px,
+              float py,
+              float f)
+{
+    for (std::size_t i = 0; i < n; i++) {
+        float dx = x[i] - px;
+        float dy = y[i] - py;
+        float dist = std::sqrt(dx * dx + dy * dy);
+        float F = 0.5 * f / dist;
+        if (dist > 1000) {
+            F *= dist / 1000;
+        }
+        Vector2 tf{ 0, 0 };
+        if (dist > 100) {
+            tf = { F * dx, F * dy };
+        } else if (dist <= 100) {
+            tf = { -2 * F * dx, -2 * F * dy };
+        }
+        vx[i] = (vx[i] + tf.x) * 0.5f;
+        vy[i] = (vy[i] + tf.y) * 0.5f;
+        x[i] += vx[i];
+        y[i] += vy[i];
+    }
+}
+
+#ifdef GAME7_X86_SIMD
+__attribute__((target("sse2"))) void
+force_sse(float px,
+          float py,
+          const float* bx,
+          const float* by,
+          const float* bm,
+          const std::uint32_t* idx,
+          std::size_t n,
+          const force_term* terms,
+          std::size_t m,
+          Vector2* out)
+{
+    const __m128 vpx = _mm_set1_ps(px);
+    const __m128 vpy = _mm_set1_ps(py);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 vk[max_force_terms], vr[max_force_terms];
+    __m128 sx[max_force_terms], sy[max_force_terms];
+    for (std::size_t t = 0; t < m; t++) {
+        vk[t] = _mm_set1_ps(0.5f * terms[t].f);
+        vr[t] = _mm_set1_ps(terms[t].effective_dist);
+        sx[t] = zero;
+        sy[t] = zero;
+    }
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x, y, mass;
+        if (idx) {
+            // sse has no gather
+            x = _mm_set_ps(
+              bx[idx[i + 3]], bx[idx[i + 2]], bx[idx[i + 1]], bx[idx[i]]);
+            y = _mm_set_ps(
+              by[idx[i + 3]], by[idx[i + 2]], by[idx[i + 1]], by[idx[i]]);
+            mass = _mm_set_ps(
+              bm[idx[i + 3]], bm[idx[i + 2]], bm[idx[i + 1]], bm[idx[i]]);
+        } else {
+            x = _mm_loadu_ps(bx + i);
+            y = _mm_loadu_ps(by + i);
+            mass = _mm_loadu_ps(bm + i);
+        }
+        __m128 dx = _mm_sub_ps(vpx, x);
+        __m128 dy = _mm_sub_ps(vpy, y);
+        __m128 dist =
+          _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 nonzero = _mm_cmpgt_ps(dist, zero);
+        __m128 inv = _mm_div_ps(mass, dist);
+        for (std::size_t t = 0; t < m; t++) {
+            // out of range lanes (including dist == 0) contribute nothing
+            __m128 in_range = _mm_and_ps(nonzero, _mm_cmplt_ps(dist, vr[t]));
+            __m128 F = _mm_and_ps(in_range, _mm_mul_ps(inv, vk[t]));
+            sx[t] = _mm_add_ps(sx[t], _mm_mul_ps(F, dx));
+            sy[t] = _mm_add_ps(sy[t], _mm_mul_ps(F, dy));
+        }
+    }
+    for (std::size_t t = 0; t < m; t++) {
+        alignas(16) float lx[4], ly[4];
+        _mm_store_ps(lx, sx[t]);
+        _mm_store_ps(ly, sy[t]);
+        out[t].x += lx[0] + lx[1] + lx[2] + lx[3];
+        out[t].y += ly[0] + ly[1] + ly[2] + ly[3];
+    }
+    force_scalar(px,
+                 py,
+                 bx + (idx ? 0 : i),
+                 by + (idx ? 0 : i),
+                 bm + (idx ? 0 : i),
+                 idx ? idx + i : nullptr,
+                 n - i,
+                 terms,
+                 m,
+                 out);
+}
+
+__attribute__((target("avx2"))) void
+force_avx2(float px,
+           float py,
+           const float* bx,
+           const float* by,
+           const float* bm,
+           const std::uint32_t* idx,
+           std::size_t n,
+           const force_term* terms,
+           std::size_t m,
+           Vector2* out)
+{
+    const __m256 vpx = _mm256_set1_ps(px);
+    const __m256 vpy = _mm256_set1_ps(py);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 vk[max_force_terms], vr[max_force_terms];
+    __m256 sx[max_force_terms], sy[max_force_terms];
+    for (std::size_t t = 0; t < m; t++) {
+        vk[t] = _mm256_set1_ps(0.5f * terms[t].f);
+        vr[t] = _mm256_set1_ps(terms[t].effective_dist);
+        sx[t] = zero;
+        sy[t] = zero;
+    }
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x, y, mass;
+        if (idx) {
+            __m256i vi =
+              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx + i));
+            x = _mm256_i32gather_ps(bx, vi, 4);
+            y = _mm256_i32gather_ps(by, vi, 4);
+            mass = _mm256_i32gather_ps(bm, vi, 4);
+        } else {
+            x = _mm256_loadu_ps(bx + i);
+            y = _mm256_loadu_ps(by + i);
+            mass = _mm256_loadu_ps(bm + i);
+        }
+        __m256 dx = _mm256_sub_ps(vpx, x);
+        __m256 dy = _mm256_sub_ps(vpy, y);
+        __m256 dist = _mm256_sqrt_ps(
+          _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 nonzero = _mm256_cmp_ps(dist, zero, _CMP_GT_OQ);
+        __m256 inv = _mm256_div_ps(mass, dist);
+        for (std::size_t t = 0; t < m; t++) {
+            __m256 in_range = _mm256_and_ps(
+              nonzero, _mm256_cmp_ps(dist, vr[t], _CMP_LT_OQ));
+            __m256 F = _mm256_and_ps(in_range, _mm256_mul_ps(inv, vk[t]));
+            sx[t] = _mm256_add_ps(sx[t], _mm256_mul_ps(F, dx));
+            sy[t] = _mm256_add_ps(sy[t], _mm256_mul_ps(F, dy));
+        }
+    }
+    for (std::size_t t = 0; t < m; t++) {
+        alignas(32) float lx[8], ly[8];
+        _mm256_store_ps(lx, sx[t]);
+        _mm256_store_ps(ly, sy[t]);
+        for (int l = 0; l < 8; l++) {
+            out[t].x += lx[l];
+            out[t].y += ly[l];
+        }
+    }
+    force_scalar(px,
+                 py,
+                 bx + (idx ? 0 : i),
+                 by + (idx ? 0 : i),
+                 bm + (idx ? 0 : i),
+                 idx ? idx + i : nullptr,
+                 n - i,
+                 terms,
+                 m,
+                 out);
+}
+
+__attribute__((target("sse2"))) void
+player_sse(float* x,
+           float* y,
+           float* vx,
+           float* vy,
+           std::size_t n,
+           float px,
+           float py,
+           float f)
+{
+    const __m128 vpx = _mm_set1_ps(px);
+    const __m128 vpy = _mm_set1_ps(py);
+    const __m128 vk = _mm_set1_ps(0.5f * f);
+    const __m128 far = _mm_set1_ps(1000);
+    const __m128 near = _mm_set1_ps(100);
+    const __m128 one = _mm_set1_ps(1);
+    const __m128 minus_two = _mm_set1_ps(-2);
+    const __m128 half = _mm_set1_ps(0.5f);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), vpx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), vpy);
+        __m128 dist =
+          _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 F = _mm_div_ps(vk, dist);
+        // F *= dist / 1000 beyond 1000, pushed away (-2F) inside 100
+        __m128 is_far = _mm_cmpgt_ps(dist, far);
+        __m128 scale = _mm_or_ps(_mm_and_ps(is_far, _mm_div_ps(dist, far)),
+                                 _mm_andnot_ps(is_far, one));
+        __m128 is_out = _mm_cmpgt_ps(dist, near);
+        __m128 sign = _mm_or_ps(_mm_and_ps(is_out, one),
+                                _mm_andnot_ps(is_out, minus_two));
+        F = _mm_mul_ps(F, _mm_mul_ps(scale, sign));
+        __m128 nvx =
+          _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), _mm_mul_ps(F, dx)), half);
+        __m128 nvy =
+          _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), _mm_mul_ps(F, dy)), half);
+        _mm_storeu_ps(vx + i, nvx);
+        _mm_storeu_ps(vy + i, nvy);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), nvx));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), nvy));
+    }
+    player_scalar(x + i, y + i, vx + i, vy + i, n - i, px, py, f);
+}
+
+__attribute__((target("avx2"))) void
+player_avx2(float* x,
+            float* y,
+            float* vx,
+            float* vy,
+            std::size_t n,
+            float px,
+            float py,
+            float f)
+{
+    const __m256 vpx = _mm256_set1_ps(px);
+    const __m256 vpy = _mm256_set1_ps(py);
+    const __m256 vk = _mm256_set1_ps(0.5f * f);
+    const __m256 far = _mm256_set1_ps(1000);
+    const __m256 near = _mm256_set1_ps(100);
+    const __m256 one = _mm256_set1_ps(1);
+    const __m256 minus_two = _mm256_set1_ps(-2);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), vpx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), vpy);
+        __m256 dist = _mm256_sqrt_ps(
+          _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 F = _mm256_div_ps(vk, dist);
+        __m256 scale = _mm256_blendv_ps(one,
+                                        _mm256_div_ps(dist, far),
+                                        _mm256_cmp_ps(dist, far, _CMP_GT_OQ));
+        __m256 sign = _mm256_blendv_ps(
+          minus_two, one, _mm256_cmp_ps(dist, near, _CMP_GT_OQ));
+        F = _mm256_mul_ps(F, _mm256_mul_ps(scale, sign));
+        __m256 nvx = _mm256_mul_ps(
+          _mm256_add_ps(_mm256_loadu_ps(vx + i), _mm256_mul_ps(F, dx)), half);
+        __m256 nvy = _mm256_mul_ps(
+          _mm256_add_ps(_mm256_loadu_ps(vy + i), _mm256_mul_ps(F, dy)), half);
+        _mm256_storeu_ps(vx + i, nvx);
+        _mm256_storeu_ps(vy + i, nvy);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), nvx));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), nvy));
+    }
+    player_scalar(x + i, y + i, vx + i, vy + i, n - i, px, py, f);
+}
+#endif
+
+kernel_set
+kernels_for(simd_level level)
+{
+    switch (level) {
+#ifdef GAME7_X86_SIMD
+        case simd_level::avx2:
+            return { force_avx2, player_avx2 };
+        case simd_level::sse:
+            return { force_sse, player_sse };
+#endif
+        default:
+            return { force_scalar, player_scalar };
+    }
+}
+
+struct dispatch
+{
+    simd_level level;
+    kernel_set kernels;
+};
+
+dispatch&
+active()
+{
+    static dispatch d{ detect_simd_level(),
+                       kernels_for(detect_simd_level()) };
+    return d;
+}
+};
+
+simd_level
+detect_simd_level()
+{
+#ifdef GAME7_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return simd_level::avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return simd_level::sse;
+    }
+#endif
+    return simd_level::scalar;
+}
+
+simd_level
+active_simd_level()
+{
+    return active().level;
+}
+
+simd_level
+set_simd_level(simd_level level)
+{
+    if (level > detect_simd_level()) {
+        level = detect_simd_level();
+    }
+    active() = { level, kernels_for(level) };
+    return level;
+}
+
+const char*
+simd_level_name(simd_level level)
+{
+    switch (level) {
+        case simd_level::avx2:
+            return "avx2";
+        case simd_level::sse:
+            return "sse";
+        default:
+            return "scalar";
+    }
+}
+
+void
+accumulate_forces(float px,
+                  float py,
+                  const drone_store& b,
+                  const std::uint32_t* idx,
+                  std::size_t n,
+                  const force_term* terms,
+                  std::size_t m,
+                  Vector2* out)
+{
+    for (std::size_t t = 0; t < m; t++) {
+        out[t] = { 0, 0 };
+    }
+    active().kernels.force(px,
+                           py,
+                           b.x.data(),
+                           b.y.data(),
+                           b.mass.data(),
+                           idx,
+                           n,
+                           terms,
+                           m,
+                           out);
+}
+
+void
+add_forces(float px,
+           float py,
+           const float* bx,
+           const float* by,
+           const float* bm,
+           std::size_t n,
+           const force_term* terms,
+           std::size_t m,
+           Vector2* out)
+{
+    active().kernels.force(px, py, bx, by, bm, nullptr, n, terms, m, out);
+}
+
+Vector2
+accumulate_force(float px,
+                 float py,
+                 const drone_store& b,
+                 const std::uint32_t* idx,
+                 std::size_t n,
+                 float f,
+                 float effective_dist)
+{
+    force_term term{ f, effective_dist };
+    Vector2 tf;
+    accumulate_forces(px, py, b, idx, n, &term, 1, &tf);
+    return tf;
+}
+
+void
+player_force(drone_store& a,
+             const Vector2& player_pos,
+             float f,
+             std::size_t begin,
+             std::size_t end)
+{
+    active().kernels.player(a.x.data() + begin,
+                            a.y.data() + begin,
+                            a.vx.data() + begin,
+                            a.vy.data() + begin,
+                            end - begin,
+                            player_pos.x,
+                            player_pos.y,
+                            f);
+}
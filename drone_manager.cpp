@@ -0,0 +1,512 @@
+#include "drone_manager.h"
+#include "drone_kernels.h"
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <raylib.h>
+#include <raymath.h>
+
+#ifdef GAME7_PROFILE
+namespace {
+// zone names have to be literals
+const char*
+interact_zone(species s)
+{
+    switch (s) {
+        case species::green:
+            return "interact green";
+        case species::red:
+            return "interact red";
+        default:
+            return "interact yellow";
+    }
+}
+};
+#endif
+
+drone_manager::drone_manager(int n, std::mt19937& gen, unsigned threads)
+  : green_index(broadphase::grid, 100)
+  , yellow_index(broadphase::grid, 100)
+  , red_index(broadphase::grid, 100)
+  , player(1)
+  , pool(threads)
+{
+    auto xd = std::uniform_int_distribution<>{ 0, 1920 };
+    auto yd = std::uniform_int_distribution<>{ 0, 1920 };
+    for (int i = 0; i < n; i++) {
+        drone g{ .health = 1 };
+        g.pos = { float(xd(gen)), float(yd(gen)) };
+        green.insert(g);
+    }
+    for (int i = 0; i < 3; i++) {
+        drone g{ .mass = 150.f, .health = 100 };
+        g.pos = { float(xd(gen)), float(yd(gen)) };
+        red.insert(g);
+    }
+    for (int i = 0; i < n; i++) {
+        drone g{ .health = 1 };
+        g.pos = { float(xd(gen)), float(yd(gen)) };
+        yellow.insert(g);
+    }
+    player[0].pos = { 1920.f / 2, 1080.f / 2 };
+
+    auto rules = [this](species a, species b) -> std::vector<force_term>& {
+        return interactions[std::size_t(a)][std::size_t(b)];
+    };
+    rules(species::green, species::green) = { { -0.32, 200 }, { 0.3, 70 } };
+    rules(species::green, species::red) = { { 0.8, 50 }, { -0.17, 200 } };
+    // { 0.5, 10 } green against red
+    rules(species::green, species::yellow) = { { 0.34, 200 } };
+    rules(species::red, species::green) = { { -0.34, 200 } };
+    rules(species::red, species::red) = { { 0.1, 400 } };
+    // { 0.8, 50 } red against red
+    rules(species::red, species::yellow) = { { 0.3, 100 } };
+    rules(species::yellow, species::green) = { { -0.2, 200 } };
+    rules(species::yellow, species::yellow) = { { 0.15, 60 } };
+}
+
+drone_buffers&
+drone_manager::state_for(species s)
+{
+    switch (s) {
+        case species::green:
+            return green_state;
+        case species::red:
+            return red_state;
+        default:
+            return yellow_state;
+    }
+}
+
+drone_index&
+drone_manager::index_for(species s)
+{
+    switch (s) {
+        case species::green:
+            return green_index;
+        case species::red:
+            return red_index;
+        default:
+            return yellow_index;
+    }
+}
+
+void
+drone_manager::interact(species a)
+{
+    GAME7_ZONE(interact_zone(a));
+    auto& sa = state_for(a);
+    auto const& src = sa.read;
+    auto const& rules = interactions[std::size_t(a)];
+    // drones sitting the tick out keep what pack copied into write
+    auto const& adv = advance[std::size_t(a)];
+    std::uint32_t const* due = adv.empty() ? nullptr : adv.data();
+
+    // one query per source species, reaching as far as its furthest rule
+    std::array<float, species_count> reach{};
+    std::size_t term_count = 0;
+    for (std::size_t b = 0; b < species_count; b++) {
+        for (auto const& t : rules[b]) {
+            reach[b] = std::max(reach[b], t.effective_dist);
+        }
+        term_count += rules[b].size();
+    }
+
+    pool.parallel_for(src.size(), [&](std::size_t begin, std::size_t end) {
+        // reused so the loop does not allocate once warm
+        thread_local std::vector<std::uint32_t> idx;
+        thread_local std::vector<Vector2> tf;
+        // aggregate bodies of the barnes-hut walk
+        thread_local yhl_util::aligned_vector<float> bx, by, bm;
+        tf.resize(term_count);
+        for (auto i = begin; i < end; i++) {
+            if (due && due[i] == 0) {
+                continue;
+            }
+            float x = src.x[i];
+            float y = src.y[i];
+            std::size_t k = 0;
+            for (std::size_t b = 0; b < species_count; b++) {
+                auto const& terms = rules[b];
+                if (terms.empty()) {
+                    continue;
+                }
+                auto const& from = state_for(species(b)).read;
+                auto const& index = index_for(species(b));
+                std::uint32_t const* candidates = nullptr;
+                std::size_t n = from.size();
+                bx.clear();
+                by.clear();
+                bm.clear();
+                if (n > brute_force_below && theta > 0 &&
+                    index.kind == broadphase::quadtree) {
+                    // a node stands in for its drones only if every rule
+                    // sees all of them or none of them
+                    auto fits = [&](double lo, double hi) {
+                        for (auto const& t : terms) {
+                            if (lo < t.effective_dist &&
+                                hi >= t.effective_dist) {
+                                return false;
+                            }
+                        }
+                        return true;
+                    };
+                    idx.clear();
+                    index.qtree.approximate(
+                      x,
+                      y,
+                      reach[b],
+                      theta,
+                      fits,
+                      [&](float cx, float cy, float m) {
+                          bx.emplace_back(cx);
+                          by.emplace_back(cy);
+                          bm.emplace_back(m);
+                      },
+                      [&](std::uint32_t j) { idx.emplace_back(j); });
+                    candidates = idx.data();
+                    n = idx.size();
+                } else if (n > brute_force_below) {
+                    auto r = reach[b];
+                    idx.clear();
+                    index.query(x - r,
+                                y - r,
+                                r * 2,
+                                r * 2,
+                                [&](std::uint32_t j) { idx.emplace_back(j); });
+                    candidates = idx.data();
+                    n = idx.size();
+                }
+                for (std::size_t t = 0; t < terms.size();
+                     t += max_force_terms) {
+                    auto m = std::min(max_force_terms, terms.size() - t);
+                    accumulate_forces(x,
+                                      y,
+                                      from,
+                                      candidates,
+                                      n,
+                                      terms.data() + t,
+                                      m,
+                                      tf.data() + k + t);
+                    add_forces(x,
+                               y,
+                               bx.data(),
+                               by.data(),
+                               bm.data(),
+                               bx.size(),
+                               terms.data() + t,
+                               m,
+                               tf.data() + k + t);
+                }
+                k += terms.size();
+            }
+
+            // apply the rules one after another, in table order
+            Vector2 vel{ src.vx[i], src.vy[i] };
+            Vector2 pos{ x, y };
+            for (auto const& f : tf) {
+                if (f.x != 0 && f.y != 0) {
+                    vel = Vector2Scale(vel + f, 0.5);
+                    vel = Vector2ClampValue(vel, 1.f, 10.f);
+                    pos = pos + vel;
+                }
+            }
+            sa.write.vx[i] = vel.x;
+            sa.write.vy[i] = vel.y;
+            sa.write.x[i] = pos.x;
+            sa.write.y[i] = pos.y;
+        }
+    });
+}
+void
+drone_manager::player_rule(species a,
+                           const Vector2& player_pos,
+                           float f,
+                           float effective_dist)
+{
+    GAME7_ZONE("player rule");
+    auto& sa = state_for(a);
+    auto const& adv = advance[std::size_t(a)];
+    std::uint32_t const* due = adv.empty() ? nullptr : adv.data();
+    // every drone only reads itself, so this one runs in place
+    pool.parallel_for(sa.size(), [&](std::size_t begin, std::size_t end) {
+        if (!due) {
+            player_force(sa.read, player_pos, f, begin, end);
+            return;
+        }
+        // the kernel takes runs of consecutive drones that are due
+        auto i = begin;
+        while (i < end) {
+            while (i < end && due[i] == 0) {
+                i++;
+            }
+            auto first = i;
+            while (i < end && due[i] != 0) {
+                i++;
+            }
+            if (first < i) {
+                player_force(sa.read, player_pos, f, first, i);
+            }
+        }
+    });
+}
+
+void
+drone_manager::plan_lod(const Vector2& player_pos,
+                        const std::array<std::size_t, species_count>& owned)
+{
+    GAME7_ZONE("plan lod");
+    auto const& l = *lod_settings;
+    auto every = std::max<std::uint32_t>(l.reduced_every, 1);
+    auto sq = [](float r) { return r * r; };
+    auto dist2 = [&](Vector2 p) {
+        float dx = p.x - player_pos.x;
+        float dy = p.y - player_pos.y;
+        return dx * dx + dy * dy;
+    };
+    // whether a drone inside sleep_radius is within neighbor_radius of p.
+    // only reads positions, which nothing here writes
+    auto nudged = [&](Vector2 p) {
+        float r = l.neighbor_radius;
+        bool found = false;
+        for (auto b : { species::green, species::red, species::yellow }) {
+            auto const& others = drones(b);
+            index_for(b).query(p.x - r, p.y - r, r * 2, r * 2, [&](auto j) {
+                auto q = others[j].pos;
+                float dx = q.x - p.x;
+                float dy = q.y - p.y;
+                if (!found && dx * dx + dy * dy < sq(r) &&
+                    dist2(q) < sq(l.sleep_radius)) {
+                    found = true;
+                }
+            });
+            if (found) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (auto s : { species::green, species::red, species::yellow }) {
+        auto& ds = drones(s);
+        auto& adv = advance[std::size_t(s)];
+        auto n = owned[std::size_t(s)];
+        // ghosts sit every tick out
+        adv.assign(ds.size(), 0);
+        std::atomic<std::size_t> active{ 0 }, reduced{ 0 }, asleep{ 0 },
+          updated{ 0 };
+        pool.parallel_for(n, [&](std::size_t begin, std::size_t end) {
+            lod_counts c;
+            for (auto i = begin; i < end; i++) {
+                auto& d = ds[i];
+                auto d2 = dist2(d.pos);
+                // the reduced tier and the sleepers' checks take turns
+                bool turn = (ticks + i) % every == 0;
+                if (d.asleep) {
+                    if (d2 < sq(l.wake_radius) || (turn && nudged(d.pos))) {
+                        d.asleep = false;
+                        d.stay_awake = l.linger;
+                    }
+                } else if (d.stay_awake > 0) {
+                    d.stay_awake--;
+                } else if (d2 > sq(l.sleep_radius)) {
+                    d.asleep = true;
+                }
+
+                if (d.asleep) {
+                    adv[i] = 0;
+                    c.asleep++;
+                } else if (d2 > sq(l.reduced_radius)) {
+                    adv[i] = turn ? every : 0;
+                    c.reduced++;
+                } else {
+                    adv[i] = 1;
+                    c.active++;
+                }
+                c.updated += adv[i] != 0;
+            }
+            active += c.active;
+            reduced += c.reduced;
+            asleep += c.asleep;
+            updated += c.updated;
+        });
+        tier_counts[std::size_t(s)] = { active, reduced, asleep, updated };
+    }
+}
+
+void
+drone_manager::scale_reduced(species s)
+{
+    auto& st = state_for(s).read;
+    auto const& ds = drones(s);
+    auto const& adv = advance[std::size_t(s)];
+    pool.parallel_for(st.size(), [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            if (adv[i] > 1) {
+                // ds still holds where the drone started the tick
+                auto from = ds[i].pos;
+                st.x[i] = from.x + (st.x[i] - from.x) * adv[i];
+                st.y[i] = from.y + (st.y[i] - from.y) * adv[i];
+            }
+        }
+    });
+}
+
+yhl_util::slot_map<drone>&
+drone_manager::drones(species s)
+{
+    switch (s) {
+        case species::green:
+            return green;
+        case species::red:
+            return red;
+        default:
+            return yellow;
+    }
+}
+
+const yhl_util::slot_map<drone>&
+drone_manager::drones(species s) const
+{
+    return const_cast<drone_manager*>(this)->drones(s);
+}
+
+void
+drone_manager::use_broadphase(broadphase kind)
+{
+    green_index.kind = kind;
+    yellow_index.kind = kind;
+    red_index.kind = kind;
+}
+
+void
+drone_manager::use_barnes_hut(float theta_)
+{
+    theta = theta_;
+}
+
+void
+drone_manager::use_lod(std::optional<sim_lod> settings)
+{
+    lod_settings = settings;
+    if (!lod_settings) {
+        for (auto& adv : advance) {
+            adv.clear();
+        }
+    }
+}
+
+float
+drone_manager::reach() const
+{
+    float r = 0;
+    for (auto const& from : interactions) {
+        for (auto const& terms : from) {
+            for (auto const& t : terms) {
+                r = std::max(r, t.effective_dist);
+            }
+        }
+    }
+    return r;
+}
+
+void
+drone_manager::tick(Vector2 const& player_pos)
+{
+    static const species_drones no_ghosts;
+    tick(player_pos, no_ghosts);
+}
+
+void
+drone_manager::tick(Vector2 const& player_pos, const species_drones& ghosts)
+{
+    GAME7_ZONE("drone tick");
+    for (auto s : { species::green, species::red, species::yellow }) {
+        GAME7_ZONE("remove dead");
+        auto& ds = drones(s);
+        auto& index = index_for(s);
+        // back to front, so the drone swapped into a hole was already checked
+        for (auto i = ds.size(); i-- > 0;) {
+            if (ds[i].health <= 0) {
+                index.swap_remove(i, ds.size() - 1);
+                ds.erase_at(i);
+            }
+        }
+    }
+
+    // ghosts go after the drones of their species for the tick
+    std::array<std::size_t, species_count> owned;
+    bool haunted = false;
+    for (auto s : { species::green, species::red, species::yellow }) {
+        auto& ds = drones(s);
+        owned[std::size_t(s)] = ds.size();
+        for (auto const& g : ghosts[std::size_t(s)]) {
+            ds.insert(g);
+        }
+        haunted |= !ghosts[std::size_t(s)].empty();
+    }
+
+    // the indices follow the drones at the end of every tick, so they only
+    // need a build here after a broadphase switch, a removal the grid could
+    // not follow or ghosts, and the quadtree's aggregates after removals
+    for (auto s : { species::green, species::red, species::yellow }) {
+        index_for(s).refresh(drones(s));
+    }
+    if (lod_settings) {
+        plan_lod(player_pos, owned);
+    } else {
+        for (auto s : { species::green, species::red, species::yellow }) {
+            auto n = owned[std::size_t(s)];
+            tier_counts[std::size_t(s)] = { n, 0, 0, n };
+            auto& adv = advance[std::size_t(s)];
+            adv.clear();
+            if (haunted) {
+                adv.assign(n, 1);
+                adv.resize(drones(s).size(), 0);
+            }
+        }
+    }
+    {
+        GAME7_ZONE("pack");
+        green_state.pack(green.values());
+        red_state.pack(red.values());
+        yellow_state.pack(yellow.values());
+    }
+
+    // every species moves against where the others were at the start of the
+    // tick, so flip only once all of them are done
+    interact(species::green);
+    interact(species::red);
+    interact(species::yellow);
+    green_state.flip();
+    red_state.flip();
+    yellow_state.flip();
+
+    player_rule(species::yellow, player_pos, -0.2, 500);
+    player_rule(species::green, player_pos, -1.4, 2000);
+    player_rule(species::red, player_pos, -1.4, 2000);
+
+    {
+        GAME7_ZONE("unpack");
+        if (lod_settings) {
+            scale_reduced(species::green);
+            scale_reduced(species::red);
+            scale_reduced(species::yellow);
+        }
+        green_state.unpack(green);
+        red_state.unpack(red);
+        yellow_state.unpack(yellow);
+    }
+    if (haunted) {
+        for (auto s : { species::green, species::red, species::yellow }) {
+            auto& ds = drones(s);
+            while (ds.size() > owned[std::size_t(s)]) {
+                ds.erase_at(ds.size() - 1);
+            }
+        }
+    }
+    green_index.update(green);
+    red_index.update(red);
+    yellow_index.update(yellow);
+    ticks++;
+}
@@ -0,0 +1,129 @@
+#include "frame_snapshot.h"
+#include "drone_batch.h"
+#include "profiler.h"
+#include <algorithm>
+#include <raymath.h>
+
+void
+capture(frame_snapshot& snap, game& g, Vector2 cursor, float margin)
+{
+    GAME7_ZONE("capture");
+    snap.tick = g.tick();
+    snap.camera = g.camera;
+    snap.cursor = cursor;
+    snap.debug = g.debug;
+
+    view v{ g.camera, { game::screen_width, game::screen_height } };
+    float slack = margin / std::max(g.camera.zoom, 1e-3f);
+    thread_local std::vector<std::uint32_t> visible;
+    for (auto s : { species::green, species::red, species::yellow }) {
+        auto const& ds = g.dm.drones(s);
+        auto r = drone_radius(s) + slack;
+        cull(visible, ds.values(), g.dm.index_for(s), r, v);
+        auto& pos = snap.drones[std::size_t(s)];
+        auto& handles = snap.handles[std::size_t(s)];
+        pos.resize(visible.size());
+        handles.resize(visible.size());
+        for (std::size_t k = 0; k < visible.size(); k++) {
+            pos[k] = ds[visible[k]].pos;
+            handles[k] = ds.handle_at(visible[k]);
+        }
+    }
+
+    auto n = g.bullets.size();
+    snap.bullets.assign(g.bullets.pos.begin(), g.bullets.pos.begin() + n);
+    snap.bullet_vel.assign(g.bullets.vel.begin(), g.bullets.vel.begin() + n);
+    snap.bullet_age.assign(g.bullets.age.begin(), g.bullets.age.begin() + n);
+    snap.bullet_life.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+        snap.bullet_life[i] = g.bullets.progress(i);
+    }
+    n = g.explosions.size();
+    snap.explosions.assign(g.explosions.pos.begin(),
+                           g.explosions.pos.begin() + n);
+    snap.explosion_life.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+        snap.explosion_life[i] = g.explosions.progress(i);
+    }
+
+    const ship* ships[] = { &g.s, &g.y };
+    for (std::size_t i = 0; i < snap.ships.size(); i++) {
+        auto& sv = snap.ships[i];
+        sv.center = ships[i]->get_center();
+        sv.mounts.clear();
+        sv.attached.clear();
+        for (auto const& m : ships[i]->mounting_points) {
+            sv.mounts.emplace_back(m.get_center());
+            sv.attached.emplace_back(m.attachment.has_value());
+        }
+    }
+    snap.turret.reset();
+    if (g.t.attachment_point) {
+        snap.turret = (*g.t.attachment_point)->get_center();
+    }
+}
+
+void
+interpolate(const frame_snapshot& prev,
+            const frame_snapshot& cur,
+            float alpha,
+            frame_snapshot& out,
+            std::vector<std::uint32_t>& by_slot)
+{
+    GAME7_ZONE("interpolate");
+    constexpr std::uint32_t none = ~0u;
+    out.tick = cur.tick;
+    out.time = cur.time;
+    out.camera = cur.camera;
+    out.cursor = cur.cursor;
+    out.debug = cur.debug;
+
+    for (std::size_t s = 0; s < species_count; s++) {
+        auto const& from = prev.drones[s];
+        auto const& from_handles = prev.handles[s];
+        auto const& to = cur.drones[s];
+        auto const& to_handles = cur.handles[s];
+        // where each slot's drone was in prev
+        for (std::uint32_t j = 0; j < from.size(); j++) {
+            auto slot = from_handles[j].index();
+            if (slot >= by_slot.size()) {
+                by_slot.resize(slot + 1, none);
+            }
+            by_slot[slot] = j;
+        }
+        auto& pos = out.drones[s];
+        pos.resize(to.size());
+        for (std::size_t k = 0; k < to.size(); k++) {
+            auto slot = to_handles[k].index();
+            auto j = slot < by_slot.size() ? by_slot[slot] : none;
+            if (j != none && from_handles[j] == to_handles[k]) {
+                pos[k] = Vector2Lerp(from[j], to[k], alpha);
+            } else {
+                pos[k] = to[k];
+            }
+        }
+        out.handles[s] = to_handles;
+        // leave the table empty for the next species and frame
+        for (auto h : from_handles) {
+            by_slot[h.index()] = none;
+        }
+    }
+
+    // a bullet flew its velocity every tick since prev
+    float ticks = float(cur.tick - std::min(prev.tick, cur.tick));
+    float behind = (1 - alpha) * ticks;
+    auto n = cur.bullets.size();
+    out.bullets.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+        // not back past where it was fired
+        float back = std::min(behind, float(cur.bullet_age[i]));
+        out.bullets[i] = cur.bullets[i] - cur.bullet_vel[i] * back;
+    }
+    out.bullet_vel = cur.bullet_vel;
+    out.bullet_age = cur.bullet_age;
+    out.bullet_life = cur.bullet_life;
+    out.explosions = cur.explosions;
+    out.explosion_life = cur.explosion_life;
+    out.ships = cur.ships;
+    out.turret = cur.turret;
+}
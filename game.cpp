@@ -0,0 +1,160 @@
+#include "game.h"
+#include "profiler.h"
+#include <chrono>
+#include <cstring>
+#include <raymath.h>
+
+Rectangle
+place_center_at(Rectangle& r, Vector2& c)
+{
+    r.x = c.x - r.width / 2;
+    r.y = c.y - r.height / 2;
+    return r;
+}
+
+Rectangle
+place_center_at(Rectangle& r, Vector2&& c)
+{
+    r.x = c.x - r.width / 2;
+    r.y = c.y - r.height / 2;
+    return r;
+}
+
+Rectangle
+mounting_point::get_bounding_box() const
+{
+    auto r = Rectangle{ 0, 0, 20, 20 };
+    return place_center_at(r, get_center());
+}
+
+Vector2
+ship::get_center() const
+{
+    return { x + 20.f, y + 50.f };
+}
+
+Vector2
+mounting_point::get_center() const
+{
+    return (Vector2{ float(offset.x()), float(offset.y()) } +
+            parent.get_center());
+}
+
+namespace {
+// fnv-1a, over the bytes of each value
+struct state_hash
+{
+    std::uint64_t h{ 14695981039346656037ull };
+
+    template<typename T>
+    void add(const T& v)
+    {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &v, sizeof(T));
+        for (auto b : bytes) {
+            h = (h ^ b) * 1099511628211ull;
+        }
+    }
+};
+};
+
+game::game(std::uint32_t seed, int drones, unsigned threads, double tick_rate)
+  : gen(seed)
+  , dm(drones, gen, threads)
+  , fire_ticks(sim_clock::ticks_for(std::chrono::milliseconds(10), tick_rate))
+  , bullet_ticks(sim_clock::ticks_for(std::chrono::seconds(5), tick_rate))
+  , explosion_ticks(
+      sim_clock::ticks_for(std::chrono::milliseconds(400), tick_rate))
+{
+    s.mounting_points.emplace_back(
+      mounting_point{ .offset{ 20, 10 }, .parent = s });
+
+    s.mounting_points.emplace_back(
+      mounting_point{ .offset{ -20, 10 }, .parent = s });
+
+    camera.zoom = 1.0f;
+    camera.offset = { screen_width / 2, screen_height / 2 };
+}
+
+const std::vector<bullet_hit>&
+game::step(const tick_input& in)
+{
+    GAME7_ZONE("step");
+    camera.zoom += in.wheel * 0.2f;
+    camera.target = s.get_center();
+    // s.y += 1;
+
+    auto aim = GetScreenToWorld2D(in.mouse, camera);
+    for (auto m = s.mounting_points.begin(); m != s.mounting_points.end();
+         m++) {
+        if (CheckCollisionCircleRec(aim, 1, m->get_bounding_box()) &&
+            (in.buttons & tick_input::left_pressed) &&
+            !t.attachment_point.has_value()) {
+            // attach turret to ship
+            t.attachment_point = m;
+            m->attachment.emplace(t);
+        }
+        if (CheckCollisionCircleRec(aim, 1, m->get_bounding_box()) &&
+            (in.buttons & tick_input::right_pressed) &&
+            m->attachment.has_value()) {
+            t.attachment_point.value()->attachment.reset();
+            t.attachment_point = std::nullopt;
+        }
+    }
+    if (in.keys & tick_input::toggle_debug) {
+        debug = !debug;
+    }
+
+    if (in.buttons & tick_input::left_down) {
+        for (auto const& m : s.mounting_points) {
+            if (m.attachment.has_value() && ticks >= next_fire) {
+                bullets.spawn(m.get_center(),
+                              Vector2Normalize(aim - m.get_center()) * 15.f,
+                              bullet_ticks);
+                next_fire = ticks + fire_ticks;
+            }
+        }
+    }
+    dm.tick(s.get_center());
+    GAME7_ZONE("bullets");
+    bullet_from.assign(bullets.pos.begin(),
+                       bullets.pos.begin() + bullets.size());
+    bullets.advance();
+    auto const& hits = collisions.collide(
+      bullet_from, { bullets.pos.data(), bullets.size() }, 4, dm);
+    for (auto const& h : hits) {
+        bullets.kill(h.bullet);
+        if (auto* d = dm.drones(h.kind).get(h.drone)) {
+            d->health -= 1;
+        }
+        explosions.spawn(h.pos, { 0, 0 }, explosion_ticks);
+    }
+    bullets.expire();
+    explosions.advance();
+    explosions.expire();
+    ticks++;
+    return hits;
+}
+
+std::uint64_t
+game::checksum() const
+{
+    state_hash h;
+    h.add(ticks);
+    h.add(camera.zoom);
+    h.add(t.attachment_point.has_value());
+    for (auto s : { species::green, species::red, species::yellow }) {
+        for (auto const& d : dm.drones(s)) {
+            h.add(d.pos);
+            h.add(d.vel);
+            h.add(d.health);
+        }
+    }
+    for (auto const* p : { &bullets, &explosions }) {
+        for (std::size_t i = 0; i < p->size(); i++) {
+            h.add(p->pos[i]);
+            h.add(p->age[i]);
+        }
+    }
+    return h.h;
+}
@@ -0,0 +1,496 @@
+#include "drone_manager.h"
+#include "game.h"
+#include "profiler.h"
+#include "replay.h"
+#include "sim_clock.h"
+#include "shard.h"
+#include "snapshot.h"
+#include "world.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <raylib.h>
+
+/*
+headless driver: no window, no draw calls. the swarm is stepped with a fixed
+timestep as fast as the cpu allows and the achieved ticks/sec is reported
+
+usage: game7_headless [--drones n] [--ticks n] [--seed n]
+                      [--broadphase grid|quadtree] [--threads n]
+                      [--theta x] [--lod n] [--load file]
+                      [--save file | --save-quantized file]
+                      [--world n [--chunk-dir dir]] [--shards n]
+                      [--profile file]
+       game7_headless --replay file [--threads n]
+                      [--save file | --save-quantized file] [--profile file]
+
+--theta approximates the rules barnes-hut style at that opening angle, it
+only applies with the quadtree broadphase
+
+--lod n runs drones past sim_lod's reduced radius every n ticks and puts
+the farthest to sleep, see sim_lod. the drones in each tier are reported
+with the ticks/sec
+
+--world n simulates an n by n chunk world, --drones of each species per
+chunk, streaming the chunks in and out around a player circling its
+middle. the chunks away from the player are kept compressed in memory, or
+in dir with --chunk-dir; a world left in dir is picked up by the next run
+instead of seeding a new one
+
+--shards n splits the swarm into n strips run by n worker processes, each
+on --threads threads (1 by default), trading ghosts and migrating drones
+with the strips next to it every tick, see run_sharded. the whole swarm is
+back in this process at the end, for --save
+
+--replay runs the whole game a log from game7 --record describes (its seed,
+swarm, simd level, broadphase and input) instead of the bare swarm, and ends
+with the checksum the windowed run printed
+
+--load starts the swarm from a snapshot instead of the seed, --save writes
+one when the run ends, so long runs can be checkpointed and big scenarios
+set up once. --save-quantized writes the drones' positions as 16 bit codes,
+smaller but not exact, see snapshot
+
+--profile prints the p50/p99/max of every zone at the end and writes them
+all to file as a chrome trace (chrome://tracing, ui.perfetto.dev)
+*/
+
+namespace {
+// every drone_manager::tick advances the simulation by one tick of sim_clock
+constexpr double sim_dt = 1.0 / sim_clock::default_tick_rate;
+
+struct headless_options
+{
+    int drones{ 1000 };
+    std::uint64_t ticks{ 600 };
+    std::uint32_t seed{ 7 };
+    broadphase index{ broadphase::grid };
+    // 0 uses every hardware thread
+    unsigned threads{ 0 };
+    // barnes-hut opening angle, 0 is exact
+    float theta{ 0 };
+    // reduced tier stride, 0 runs every drone every tick
+    std::uint32_t lod{ 0 };
+    // chunks along a side of the streamed world, 0 is no world
+    int world{ 0 };
+    const char* chunk_dir{ nullptr };
+    // worker processes, 0 runs the swarm in this one
+    unsigned shards{ 0 };
+    const char* replay{ nullptr };
+    const char* load{ nullptr };
+    const char* save{ nullptr };
+    bool quantized_save{ false };
+    const char* profile{ nullptr };
+};
+
+bool
+parse_options(int argc, char** argv, headless_options& opts)
+{
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        if (std::strcmp(argv[i], "--drones") == 0) {
+            opts.drones = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--ticks") == 0) {
+            opts.ticks = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seed") == 0) {
+            opts.seed = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            opts.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--theta") == 0) {
+            opts.theta = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--lod") == 0) {
+            opts.lod = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--world") == 0) {
+            opts.world = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--shards") == 0) {
+            opts.shards = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--chunk-dir") == 0) {
+            opts.chunk_dir = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0) {
+            opts.replay = argv[++i];
+        } else if (std::strcmp(argv[i], "--load") == 0) {
+            opts.load = argv[++i];
+        } else if (std::strcmp(argv[i], "--save") == 0) {
+            opts.save = argv[++i];
+        } else if (std::strcmp(argv[i], "--save-quantized") == 0) {
+            opts.save = argv[++i];
+            opts.quantized_save = true;
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            opts.profile = argv[++i];
+        } else if (std::strcmp(argv[i], "--broadphase") == 0) {
+            i++;
+            if (std::strcmp(argv[i], "grid") == 0) {
+                opts.index = broadphase::grid;
+            } else if (std::strcmp(argv[i], "quadtree") == 0) {
+                opts.index = broadphase::quadtree;
+            } else {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    // a snapshot only holds the simulated chunks
+    return opts.drones >= 0 && opts.theta >= 0 && opts.world >= 0 &&
+           !(opts.replay && opts.load) &&
+           !(opts.world && (opts.load || opts.save)) &&
+           !(opts.world && opts.shards) &&
+           (opts.world || !opts.chunk_dir);
+}
+
+// drones of one chunk, spread over it as drone_manager spreads its own
+chunk_drones
+random_chunk(const world& w, chunk_key key, const headless_options& opts)
+{
+    std::seed_seq seq{ opts.seed,
+                       std::uint32_t(key.x),
+                       std::uint32_t(key.y) };
+    std::mt19937 gen{ seq };
+    auto corner = w.origin(key);
+    auto side = w.origin({ key.x + 1, key.y + 1 }).x - corner.x;
+    std::uniform_real_distribution<float> d{ 0, side };
+    auto place = [&](drone dr) {
+        dr.pos = { corner.x + d(gen), corner.y + d(gen) };
+        return dr;
+    };
+    chunk_drones drones;
+    for (int i = 0; i < opts.drones; i++) {
+        drones[std::size_t(species::green)].emplace_back(
+          place(drone{ .health = 1 }));
+        drones[std::size_t(species::yellow)].emplace_back(
+          place(drone{ .health = 1 }));
+    }
+    for (int i = 0; i < 3; i++) {
+        drones[std::size_t(species::red)].emplace_back(
+          place(drone{ .mass = 150.f, .health = 100 }));
+    }
+    return drones;
+}
+
+void
+report_world(const world& w)
+{
+    auto st = w.stats();
+    std::cout << "  world: " << st.stored_drones << " drones in "
+              << st.stored_chunks << " stored chunks, " << st.stored_bytes
+              << " bytes, " << st.loading << " loading, " << st.streamed_in
+              << " streamed in, " << st.streamed_out << " out\n";
+}
+
+// drones per lod tier, summed over the species
+void
+report_tiers(const drone_manager& dm)
+{
+    lod_counts total;
+    for (auto s : { species::green, species::red, species::yellow }) {
+        auto const& c = dm.lod_stats(s);
+        total.active += c.active;
+        total.reduced += c.reduced;
+        total.asleep += c.asleep;
+        total.updated += c.updated;
+    }
+    std::cout << "  lod: " << total.active << " active, " << total.reduced
+              << " reduced, " << total.asleep << " asleep, "
+              << total.updated << " updated\n";
+}
+
+// the profile of the run, if one was asked for
+bool
+report_profile(const headless_options& opts)
+{
+    if (!opts.profile) {
+        return true;
+    }
+    yhl_util::profiler::write_summary(std::cout);
+    if (!yhl_util::profiler::write_chrome_trace(opts.profile)) {
+        std::cerr << "can't write " << opts.profile << "\n";
+        return false;
+    }
+    return true;
+}
+
+int
+run_replay(const headless_options& opts)
+{
+    std::optional<replay_reader> replay;
+    try {
+        replay.emplace(opts.replay);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    auto const& header = replay->header();
+    game g{ header.seed, int(header.drones), opts.threads, header.tick_rate };
+    if (!use_recorded_setup(header, g)) {
+        std::cerr << "recorded with " << simd_level_name(header.simd)
+                  << " kernels, replaying with "
+                  << simd_level_name(active_simd_level())
+                  << ", the run may differ\n";
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    tick_input in;
+    while (replay->next(in)) {
+        g.step(in);
+    }
+    double elapsed =
+      std::chrono::duration<double>(clock::now() - start).count();
+    double tps = elapsed > 0 ? g.tick() / elapsed : 0;
+
+    std::cout << g.tick() << " ticks, " << header.drones << " drones in "
+              << elapsed << " s: " << tps << " ticks/sec ("
+              << tps / header.tick_rate << "x realtime)\n"
+              << g.tick() << " ticks, checksum " << std::hex << g.checksum()
+              << std::dec << std::endl;
+    if (!report_profile(opts)) {
+        return 1;
+    }
+    if (opts.save) {
+        try {
+            save_snapshot(opts.save, g, opts.quantized_save);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// the swarm in dm, in worker processes
+int
+run_shards(const headless_options& opts,
+           drone_manager& dm,
+           const std::function<void(drone_manager&)>& setup,
+           Vector2 player_pos,
+           std::uint64_t first_tick)
+{
+    auto layout = split_swarm(dm, opts.shards, dm.reach());
+    std::size_t drones = 0;
+    for (auto s : { species::green, species::red, species::yellow }) {
+        drones += dm.drones(s).size();
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    std::vector<shard_stats> stats;
+    try {
+        stats = run_sharded(dm,
+                            layout,
+                            opts.ticks,
+                            player_pos,
+                            opts.threads ? opts.threads : 1,
+                            setup);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    double elapsed =
+      std::chrono::duration<double>(clock::now() - start).count();
+    double tps = elapsed > 0 ? opts.ticks / elapsed : 0;
+
+    std::cout << opts.ticks << " ticks, " << drones << " drones in "
+              << opts.shards << " shards in " << elapsed << " s: " << tps
+              << " ticks/sec (" << tps * sim_dt << "x realtime)\n";
+    auto ticks = std::max<std::uint64_t>(opts.ticks, 1);
+    for (auto const& st : stats) {
+        std::cout << "  shard " << st.shard << ": " << st.drones
+                  << " drones, " << st.ghosts_sent / ticks
+                  << " ghosts/tick, " << st.migrated << " migrated, "
+                  << st.tick_seconds << " s ticking, "
+                  << st.exchange_seconds << " s exchanging\n";
+    }
+    std::cout << std::flush;
+    if (!report_profile(opts)) {
+        return 1;
+    }
+    if (opts.save) {
+        try {
+            save_snapshot(
+              opts.save, dm, first_tick + opts.ticks, opts.quantized_save);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+};
+
+int
+main(int argc, char** argv)
+{
+    headless_options opts;
+    if (!parse_options(argc, argv, opts)) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--drones n] [--ticks n] [--seed n]"
+                     " [--broadphase grid|quadtree] [--threads n]"
+                     " [--theta x] [--lod n] [--load file]"
+                     " [--save file | --save-quantized file]"
+                     " [--world n [--chunk-dir dir]] [--shards n]"
+                     " [--profile file]\n"
+                  << "       " << argv[0]
+                  << " --replay file [--threads n]"
+                     " [--save file | --save-quantized file]"
+                     " [--profile file]\n";
+        return 1;
+    }
+    yhl_util::profiler::enable(opts.profile != nullptr);
+    if (opts.replay) {
+        return run_replay(opts);
+    }
+
+    auto mtgen = std::mt19937{ opts.seed };
+    // the shards fork, which wants this process without worker threads
+    drone_manager dm{ opts.load || opts.world ? 0 : opts.drones,
+                      mtgen,
+                      opts.shards ? 1 : opts.threads };
+    auto setup = [&](drone_manager& m) {
+        m.use_broadphase(opts.index);
+        m.use_barnes_hut(opts.theta);
+        if (opts.lod > 0) {
+            m.use_lod(sim_lod{ .reduced_every = opts.lod });
+        }
+    };
+    setup(dm);
+    std::uint64_t first_tick = 0;
+    if (opts.load) {
+        try {
+            auto start = std::chrono::steady_clock::now();
+            snapshot snap{ opts.load };
+            load_snapshot(snap, dm);
+            first_tick = snap.tick();
+            opts.drones = int(dm.drones(species::green).size());
+            std::cout << "loaded " << opts.load << " at tick " << first_tick
+                      << " in "
+                      << std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                             .count() *
+                           1000
+                      << " ms\n";
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    // the ship the swarm orbits in the windowed build, see ship::get_center
+    Vector2 player_pos{ 1920.f / 2 + 20.f, 1080.f / 2 + 50.f };
+    if (opts.shards) {
+        return run_shards(opts, dm, setup, player_pos, first_tick);
+    }
+
+    std::optional<world> w;
+    // the player circles the world's middle at 10 units a tick
+    Vector2 middle{ 0, 0 };
+    float orbit = 0;
+    if (opts.world) {
+        try {
+            world_settings settings;
+            if (opts.chunk_dir) {
+                settings.directory = opts.chunk_dir;
+            }
+            // the world brings its own reds
+            for (auto s : { species::green, species::red, species::yellow }) {
+                dm.drones(s).clear();
+                dm.index_for(s).invalidate();
+            }
+            w.emplace(dm, settings);
+            auto start = std::chrono::steady_clock::now();
+            if (w->stats().stored_chunks == 0) {
+                for (int y = 0; y < opts.world; y++) {
+                    for (int x = 0; x < opts.world; x++) {
+                        w->seed({ x, y }, random_chunk(*w, { x, y }, opts));
+                    }
+                }
+            }
+            std::cout << "world ready in "
+                      << std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count()
+                      << " s\n";
+            report_world(*w);
+            middle = w->origin({ opts.world, opts.world });
+            middle = { middle.x / 2, middle.y / 2 };
+            orbit = middle.x * 2 / 3;
+            player_pos = { middle.x + orbit, middle.y };
+            // start with the player's chunks in
+            w->stream(player_pos);
+            w->flush();
+            w->stream(player_pos);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    auto last_report = start;
+    std::uint64_t last_tick = 0;
+    for (std::uint64_t tick = 1; tick <= opts.ticks; tick++) {
+        dm.tick(player_pos);
+        if (w) {
+            float angle = 10.f * tick / orbit;
+            player_pos = { middle.x + orbit * std::cos(angle),
+                           middle.y + orbit * std::sin(angle) };
+            if (tick % 10 == 0) {
+                try {
+                    w->stream(player_pos);
+                } catch (const std::exception& e) {
+                    std::cerr << e.what() << "\n";
+                    return 1;
+                }
+            }
+        }
+
+        auto now = clock::now();
+        if (now - last_report >= std::chrono::seconds(1)) {
+            double s = std::chrono::duration<double>(now - last_report).count();
+            std::cout << "tick " << tick << ": " << (tick - last_tick) / s
+                      << " ticks/sec\n";
+            if (opts.lod > 0) {
+                report_tiers(dm);
+            }
+            if (w) {
+                report_world(*w);
+            }
+            last_report = now;
+            last_tick = tick;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    double tps = elapsed > 0 ? opts.ticks / elapsed : 0;
+
+    std::cout << opts.ticks << " ticks, " << opts.drones << " drones in "
+              << elapsed << " s: " << tps << " ticks/sec ("
+              << tps * sim_dt << "x realtime)" << std::endl;
+    if (opts.lod > 0) {
+        report_tiers(dm);
+    }
+    if (w) {
+        report_world(*w);
+    }
+    if (!report_profile(opts)) {
+        return 1;
+    }
+    if (opts.save) {
+        try {
+            save_snapshot(
+              opts.save, dm, first_tick + opts.ticks, opts.quantized_save);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
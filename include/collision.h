@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <raylib.h>
+#include <span>
+#include <vector>
+
+#include "drone_manager.h"
+#include "slot_map.h"
+
+struct bullet_hit
+{
+    // position of the bullet in the spans given to collide()
+    std::uint32_t bullet;
+    species kind;
+    yhl_util::slot_handle drone;
+    // fraction of the step the bullet had flown when it hit
+    float time;
+    // where the bullet was when it hit
+    Vector2 pos;
+};
+
+/*
+bullet against drone collision for a whole frame at once. the bullets are
+binned into grid cells, and every occupied cell queries the index of each
+species once for the drones near any of its bullets' paths. bullets fly in
+streams, so a cell usually serves several of them with one query.
+
+the test is swept: a bullet moves along the segment from where it was to
+where it is, and hits the first drone (of any species) the segment touches,
+however long the step. drones are taken at their positions after the tick
+*/
+class collision_stage
+{
+  public:
+    explicit collision_stage(float cell_size = 32);
+    /*
+    bullet i moved from from[i] to to[i] this step. at most one hit per
+    bullet, the earliest, in bullet order. the indices of dm are used as
+    tick() leaves them, built first if they are out of sync. valid until
+    the next call, the handles until their drones die
+    */
+    const std::vector<bullet_hit>& collide(std::span<const Vector2> from,
+                                           std::span<const Vector2> to,
+                                           float bullet_radius,
+                                           drone_manager& dm);
+
+  private:
+    void collide_cell(std::span<const Vector2> from,
+                      std::span<const Vector2> to,
+                      std::uint32_t first,
+                      std::uint32_t last,
+                      float bullet_radius,
+                      drone_manager& dm);
+    struct candidate
+    {
+        float time;
+        species kind;
+        std::uint32_t drone;
+    };
+    struct binned
+    {
+        std::uint64_t cell;
+        std::uint32_t bullet;
+    };
+    float cell_size;
+    std::vector<binned> bins;
+    // where each occupied cell starts in bins, and the end
+    std::vector<std::uint32_t> cells;
+    std::vector<candidate> closest;
+    std::vector<bullet_hit> hits;
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <raylib.h>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "util.h"
+
+struct drone
+{
+    Vector2 pos;
+    Vector2 vel{ 0, 0 };
+    float mass{ 1.f };
+    int health;
+    // simulation lod state, see drone_manager::use_lod
+    bool asleep{ false };
+    // ticks a woken drone is kept awake wherever it is
+    std::uint16_t stay_awake{ 0 };
+};
+
+/*
+structure-of-arrays copy of a species, the layout the rule kernels work on.
+every array starts on a 64 byte boundary
+*/
+struct drone_store
+{
+    yhl_util::aligned_vector<float> x;
+    yhl_util::aligned_vector<float> y;
+    yhl_util::aligned_vector<float> vx;
+    yhl_util::aligned_vector<float> vy;
+    yhl_util::aligned_vector<float> mass;
+    yhl_util::aligned_vector<int> health;
+
+    std::size_t size() const { return x.size(); }
+    void resize(std::size_t n);
+
+    // copy drones in, drone i becomes element i of every array
+    void pack(std::span<const drone> drones);
+    // write the state back into the drones it was packed from
+    void unpack(std::span<drone> drones) const;
+};
+
+/*
+double buffered state of a species. a rule reads every drone from read,
+writes the result to write and then flips the two, so the outcome does not
+depend on the order the drones are visited in and they can be split across
+threads
+*/
+struct drone_buffers
+{
+    drone_store read;
+    drone_store write;
+
+    void pack(std::span<const drone> drones)
+    {
+        read.pack(drones);
+        write = read;
+    }
+    void unpack(std::span<drone> drones) const { read.unpack(drones); }
+    void flip() { std::swap(read, write); }
+    std::size_t size() const { return read.size(); }
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <raylib.h>
+#include <span>
+#include <vector>
+
+#include "drone.h"
+#include "drone_index.h"
+#include "thread_pool.h"
+
+/*
+one draw of a whole species: the drones the camera sees as a single
+triangle list in world space, every drone the same number of triangles, so
+drone k of the batch owns vertices [k * per_drone, (k + 1) * per_drone) and
+the list can be filled in parallel.
+
+building the batch draws nothing, so it runs (and its vertices can be
+checked) without a window. draw() is the only part that needs one
+*/
+struct drone_batch
+{
+    // triangle list, three vertices per triangle
+    std::vector<Vector2> vertices;
+    Color color{ 255, 255, 255, 255 };
+    // the drones that survived culling, batch drone k is drones[visible[k]]
+    std::vector<std::uint32_t> visible;
+    // where batch drone k is drawn
+    std::vector<Vector2> centers;
+    // triangles per drone, 2 when they are drawn as points
+    std::uint32_t triangles{ 0 };
+    // the circles are smaller than a pixel on screen
+    bool points{ false };
+
+    std::size_t size() const { return centers.size(); }
+    std::size_t vertices_per_drone() const { return triangles * 3; }
+    // submit the batch to rlgl, must run inside BeginMode2D
+    void draw() const;
+};
+
+/*
+what the camera shows. screen is the size of the render target, the
+camera's view of it is culled against
+*/
+struct view
+{
+    Camera2D camera;
+    Vector2 screen;
+
+    // world space box around everything on screen
+    Rectangle bounds() const;
+};
+
+/*
+the drones of radius r at least partly inside the view, as positions in
+drones. index, when it is in sync with drones, finds them; otherwise every
+drone is tested
+*/
+void
+cull(std::vector<std::uint32_t>& visible,
+     std::span<const drone> drones,
+     const drone_index& index,
+     float r,
+     const view& v);
+
+/*
+the vertices of out.centers, circles of radius r seen at zoom. the circle
+gets fewer segments the smaller it is on screen, down to a one pixel square
+for drones smaller than a pixel
+*/
+void
+fill_batch(drone_batch& out,
+           float r,
+           Color color,
+           float zoom,
+           thread_pool& pool);
+
+// cull, then fill with the drones that are left
+void
+build_batch(drone_batch& out,
+            std::span<const drone> drones,
+            const drone_index& index,
+            float r,
+            Color color,
+            const view& v,
+            thread_pool& pool);
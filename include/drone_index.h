@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "drone.h"
+#include "quadtree.h"
+#include "spatial_hash_grid.h"
+
+enum class broadphase
+{
+    quadtree,
+    grid,
+};
+
+/*
+world-space index over the drones of one species, backed by either a
+quadtree or a uniform grid. both answer the same queries, so the rules do
+not care which one a species uses. queries yield positions in the drone
+array the index was built over.
+
+coordinates are floats, as the drones' own. built with GAME7_QUANTIZED_INDEX
+the quadtree keeps its entries as 16 bit codes over its area instead
+*/
+#ifdef GAME7_QUANTIZED_INDEX
+using drone_tree = yhl_util::quadtree<drone, float, std::int16_t>;
+#else
+using drone_tree = yhl_util::quadtree<drone, float>;
+#endif
+using drone_grid = yhl_util::spatial_hash_grid<drone, float>;
+
+class drone_index
+{
+  public:
+    drone_index(broadphase kind, float cell_size);
+    // what the next build makes. queries go to the one built last
+    broadphase kind;
+    // rebuild from scratch over the current drone positions
+    void build(std::span<const drone> drones);
+    /*
+    bring the index up to date with the drones after they moved. the
+    quadtree only relocates the drones that left their leaf, as long as
+    it is in sync and all are still inside the tree. anything else, and
+    the grid, rebuilds
+    */
+    void update(std::span<const drone> drones);
+    /*
+    drone i was swap-and-popped with drone last, see slot_map::erase_at.
+    the quadtree follows, the grid falls out of sync
+    */
+    void swap_remove(std::uint32_t i, std::uint32_t last);
+    /*
+    ready the index for the rules: build it if it is out of sync, and
+    bring the quadtree's masses and centers of mass back in line with the
+    drones after swap_removes, for approximate()
+    */
+    void refresh(std::span<const drone> drones);
+    // the drones were replaced wholesale, the next in_sync is false
+    void invalidate() { stale = true; }
+    // whether the index is built as kind over n drones and none have moved
+    // in the array since
+    bool in_sync(std::size_t n) const
+    {
+        return !stale && built_kind == kind && indexed == n;
+    }
+    void query(float,
+               float,
+               float,
+               float,
+               std::vector<std::uint32_t>&,
+               bool debug = false) const;
+    template<typename F>
+    void query(float x, float y, float w, float h, F&& visit) const
+    {
+        if (built_kind == broadphase::grid) {
+            grid.query(x, y, w, h, visit);
+        } else {
+            qtree.query(x, y, w, h, visit);
+        }
+    }
+    const std::vector<std::uint32_t>& query(float, float, float, float) const;
+    /*
+    whether a query over a w by h area beats testing all n drones. a grid
+    query walks every cell of the area, however empty, the quadtree only
+    descends into occupied nodes
+    */
+    bool query_beats_scan(float w, float h, std::size_t n) const
+    {
+        return built_kind == broadphase::quadtree ||
+               grid.cells_covered(w, h) < n;
+    }
+    void draw() const;
+
+    drone_tree qtree;
+    drone_grid grid;
+
+  private:
+    broadphase built_kind;
+    std::size_t indexed{ 0 };
+    bool stale{ true };
+    // drones were swap_removed since the quadtree was last summarized
+    bool unsummarized{ false };
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <raylib.h>
+
+#include "drone.h"
+
+/*
+vectorized inner loops of drone_manager's rules. the instruction set is picked
+once at runtime from what the cpu supports, with a scalar fallback
+*/
+enum class simd_level
+{
+    scalar,
+    sse,
+    avx2,
+};
+
+// best level the running cpu supports
+simd_level
+detect_simd_level();
+simd_level
+active_simd_level();
+// switch kernels, clamped to detect_simd_level(). returns the level now in use
+simd_level
+set_simd_level(simd_level level);
+const char*
+simd_level_name(simd_level level);
+
+// one rule's share of a fused force pass
+struct force_term
+{
+    float f;
+    float effective_dist;
+};
+constexpr std::size_t max_force_terms = 4;
+
+/*
+forces of several rules against the same drones of b on a drone at (px, py),
+in a single walk over them: out[t] is the total force of terms[t].
+m <= max_force_terms, idx/n as for accumulate_force
+*/
+void
+accumulate_forces(float px,
+                  float py,
+                  const drone_store& b,
+                  const std::uint32_t* idx,
+                  std::size_t n,
+                  const force_term* terms,
+                  std::size_t m,
+                  Vector2* out);
+
+/*
+as accumulate_forces over n bodies given as plain arrays (positions bx/by,
+masses bm), e.g. the aggregates of a barnes-hut walk. adds to out instead
+of overwriting it
+*/
+void
+add_forces(float px,
+           float py,
+           const float* bx,
+           const float* by,
+           const float* bm,
+           std::size_t n,
+           const force_term* terms,
+           std::size_t m,
+           Vector2* out);
+
+/*
+total force the drones of b within effective_dist exert on a drone at (px, py).
+idx/n restricts the sum to those drones of b, idx == nullptr sums the first n
+*/
+Vector2
+accumulate_force(float px,
+                 float py,
+                 const drone_store& b,
+                 const std::uint32_t* idx,
+                 std::size_t n,
+                 float f,
+                 float effective_dist);
+
+// pull/push drones [begin, end) of a towards the player and integrate them
+void
+player_force(drone_store& a,
+             const Vector2& player_pos,
+             float f,
+             std::size_t begin,
+             std::size_t end);
@@ -0,0 +1,176 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <raylib.h>
+#include <vector>
+
+#include "drone.h"
+#include "drone_kernels.h"
+#include "drone_index.h"
+#include "slot_map.h"
+#include "thread_pool.h"
+
+class snapshot;
+
+enum class species
+{
+    green,
+    red,
+    yellow,
+};
+constexpr std::size_t species_count = 3;
+
+// size a drone of the species is drawn and hit with
+constexpr float
+drone_radius(species s)
+{
+    return s == species::red ? 10.f : 2.f;
+}
+
+// some drones of every species
+using species_drones = std::array<std::vector<drone>, species_count>;
+
+/*
+simulation level of detail by distance from the player. drones within
+reduced_radius run every rule every tick. further out they run them every
+reduced_every ticks, staggered across the swarm, and move reduced_every
+ticks' worth each time. beyond sleep_radius they fall asleep and stop
+moving, still felt by the others, until the player comes within
+wake_radius or a drone inside sleep_radius comes within neighbor_radius;
+a drone woken so stays awake for linger ticks wherever it is. sleepers
+look for neighbors at the reduced rate
+*/
+struct sim_lod
+{
+    float reduced_radius{ 1000 };
+    std::uint32_t reduced_every{ 4 };
+    float sleep_radius{ 2500 };
+    float wake_radius{ 2000 };
+    float neighbor_radius{ 50 };
+    std::uint16_t linger{ 120 };
+};
+
+// drones of a species in each lod tier during the last tick
+struct lod_counts
+{
+    std::size_t active{ 0 };
+    std::size_t reduced{ 0 };
+    std::size_t asleep{ 0 };
+    // drones the rules ran on, active plus the reduced ones due
+    std::size_t updated{ 0 };
+};
+
+class drone_manager
+{
+  public:
+    // threads sizes the pool the rules run on, 0 uses every hardware thread
+    drone_manager(int n, std::mt19937& gen, unsigned threads = 0);
+    /*
+    advance the swarm by one fixed step, drones out of health are removed.
+    the indices match the drones' positions when it returns
+    */
+    void tick(Vector2 const&);
+    /*
+    as tick, with ghosts: drones another shard owns, which act on this
+    manager's drones from where they are for this one tick but are neither
+    moved nor kept
+    */
+    void tick(Vector2 const& player_pos, const species_drones& ghosts);
+    // the furthest any rule reaches
+    float reach() const;
+    /*
+    the rules work on the double buffered structure-of-arrays state of each
+    species, which tick packs from and unpacks back into the drone vectors.
+
+    interactions[a][b] are the rules (strength, radius) moving species a
+    against species b. interact(a) evaluates all of a's rules in one pass:
+    every drone queries each source species once, at the largest radius of
+    its rules, and accumulates all of them in the same walk over the
+    neighbors. the rules are then applied in table order, reading every
+    species as it was at the start of the tick
+    */
+    std::array<std::array<std::vector<force_term>, species_count>,
+               species_count>
+      interactions;
+    void interact(species a);
+    void player_rule(species a,
+                     const Vector2& player_pos,
+                     float f,
+                     float effective_dist);
+
+    /*
+    the drones of a species. handles from it stay valid across ticks until
+    the drone dies, positions in it (what the indices return) only until
+    the next tick
+    */
+    yhl_util::slot_map<drone>& drones(species s);
+    const yhl_util::slot_map<drone>& drones(species s) const;
+    // the index over drones(s)
+    drone_index& index_for(species s);
+    // the pool the rules run on, free for other stages between ticks
+    thread_pool& workers() { return pool; }
+
+    // switch every species to the given broadphase
+    void use_broadphase(broadphase kind);
+    /*
+    approximate the rules of sources indexed by a quadtree barnes-hut style,
+    with distant nodes pulling as one body at their center of mass. theta is
+    the opening angle (node width over distance) below which a node is not
+    opened, 0 keeps the exact sum. sources on the grid are always exact
+    */
+    void use_barnes_hut(float theta);
+    /*
+    update far drones less often and put the farthest to sleep, nullopt
+    runs every drone every tick. sleeping drones keep sleeping when it is
+    switched off until they are next woken
+    */
+    void use_lod(std::optional<sim_lod> settings);
+    const std::optional<sim_lod>& lod() const { return lod_settings; }
+    const lod_counts& lod_stats(species s) const
+    {
+        return tier_counts[std::size_t(s)];
+    }
+
+    drone_index green_index;
+    drone_index yellow_index;
+    drone_index red_index;
+
+  private:
+    // sources this small are summed directly instead of queried
+    static constexpr std::size_t brute_force_below = 64;
+    float theta{ 0 };
+    std::optional<sim_lod> lod_settings;
+    // ticks run, the phase of the reduced tier's stagger
+    std::uint64_t ticks{ 0 };
+
+    drone_buffers& state_for(species s);
+    /*
+    wake and put to sleep the first owned[s] drones of every species, and
+    fill advance with how many ticks each drone moves this one: 1 active,
+    reduced_every for a reduced drone that is due, 0 for one that sits it
+    out or is a ghost
+    */
+    void plan_lod(const Vector2& player_pos,
+                  const std::array<std::size_t, species_count>& owned);
+    // stretch the due reduced drones' last step over the ticks they skipped
+    void scale_reduced(species s);
+
+    yhl_util::slot_map<drone> green;
+    yhl_util::slot_map<drone> red;
+    yhl_util::slot_map<drone> yellow;
+    std::vector<drone> player;
+
+    drone_buffers green_state;
+    drone_buffers red_state;
+    drone_buffers yellow_state;
+
+    thread_pool pool;
+    // per drone, empty with lod off and no ghosts
+    std::array<std::vector<std::uint32_t>, species_count> advance;
+    std::array<lod_counts, species_count> tier_counts;
+
+    friend void load_snapshot(const snapshot&, drone_manager&);
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <raylib.h>
+#include <vector>
+
+#include "drone_manager.h"
+#include "game.h"
+#include "sim_clock.h"
+#include "slot_map.h"
+
+struct ship_view
+{
+    Vector2 center{ 0, 0 };
+    std::vector<Vector2> mounts;
+    // 1 where a turret sits on the mount
+    std::vector<std::uint8_t> attached;
+};
+
+/*
+everything render needs of one simulated tick, copied out of the game so the
+simulation can run on while it is drawn. only the drones near the camera's
+view are kept, with their handles to pair them up with the same drones in
+the frame before
+*/
+struct frame_snapshot
+{
+    std::uint64_t tick{ 0 };
+    // wall clock when the simulation published it
+    sim_clock::clock::time_point time;
+    Camera2D camera{};
+    // cursor of the last tick's input, in screen space
+    Vector2 cursor{ 0, 0 };
+    bool debug{ false };
+
+    std::array<std::vector<Vector2>, species_count> drones;
+    std::array<std::vector<yhl_util::slot_handle>, species_count> handles;
+    // bullets move vel every tick
+    std::vector<Vector2> bullets;
+    std::vector<Vector2> bullet_vel;
+    // ticks flown, and the fraction of its life that is
+    std::vector<std::uint32_t> bullet_age;
+    std::vector<float> bullet_life;
+    std::vector<Vector2> explosions;
+    std::vector<float> explosion_life;
+    std::array<ship_view, 2> ships;
+    // center of the turret, when it is mounted
+    std::optional<Vector2> turret;
+};
+
+/*
+fill snap from g as of now. the drones are culled against g's camera with a
+margin of screen pixels, so a drone drifting into view between this and
+the next snapshot is already there
+*/
+void
+capture(frame_snapshot& snap,
+        game& g,
+        Vector2 cursor,
+        float margin = 32);
+
+/*
+out becomes the scene alpha of the way from prev to cur. drones are matched
+by handle; one only in cur is drawn where it is, one only in prev (dead, or
+out of view) is dropped. by_slot is scratch kept between calls
+*/
+void
+interpolate(const frame_snapshot& prev,
+            const frame_snapshot& cur,
+            float alpha,
+            frame_snapshot& out,
+            std::vector<std::uint32_t>& by_slot);
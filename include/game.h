@@ -0,0 +1,155 @@
+#pragma once
+#include <Eigen/Dense>
+#include <Eigen/src/Geometry/Rotation2D.h>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <raylib.h>
+#include <vector>
+
+#include "collision.h"
+#include "drone_manager.h"
+#include "particle_pool.h"
+#include "sim_clock.h"
+
+struct ship;
+struct mounting_point;
+struct turret;
+class snapshot;
+
+Rectangle
+place_center_at(Rectangle& r, Vector2& c);
+Rectangle
+place_center_at(Rectangle& r, Vector2&& c);
+
+/*
+    the turrent will attach to a mounting point
+*/
+struct turret
+{
+    std::optional<std::vector<mounting_point>::iterator> attachment_point;
+    turret()
+      : attachment_point(std::nullopt)
+      , gun_angle(0)
+    {
+    }
+    float gun_angle;
+    void tick();
+};
+
+struct mounting_point
+{
+    Eigen::Vector2d offset;
+    const ship& parent;
+    Vector2 get_center() const;
+    Rectangle get_bounding_box() const;
+    std::optional<turret> attachment;
+};
+
+struct ship_param
+{
+    Eigen::Rotation2Dd angle{ M_PI / 4 };
+    float x{ 0.f };
+    float y{ 0.f };
+};
+
+struct ship
+{
+    Eigen::Rotation2Dd angle;
+    float x;
+    float y;
+    ship(const ship_param& p)
+      : angle(p.angle)
+      , x(p.x)
+      , y(p.y)
+    {
+    }
+    std::vector<mounting_point> mounting_points;
+    Vector2 get_center() const;
+    friend ship_param;
+};
+
+/*
+everything the player did that one tick reads. the window samples raylib
+once per frame, presses and wheel movement carry over until a tick takes
+them, so a frame that runs no tick loses nothing and one that runs several
+sees each press once
+*/
+struct tick_input
+{
+    enum button : std::uint8_t
+    {
+        left_down = 1 << 0,
+        left_pressed = 1 << 1,
+        right_pressed = 1 << 2,
+    };
+    enum key : std::uint8_t
+    {
+        toggle_debug = 1 << 0,
+    };
+
+    // cursor, in screen space
+    Vector2 mouse{ 0, 0 };
+    float wheel{ 0 };
+    std::uint8_t buttons{ 0 };
+    std::uint8_t keys{ 0 };
+
+    bool operator==(const tick_input& o) const
+    {
+        return mouse.x == o.mouse.x && mouse.y == o.mouse.y &&
+               wheel == o.wheel && buttons == o.buttons && keys == o.keys;
+    }
+};
+
+/*
+the simulation behind the window: the ships, the turret, the swarm, bullets
+and explosions. it reads no clock and no device, only the seed it is built
+with and the input of each step, so the same seed and inputs give the same
+run, windowed or headless
+*/
+class game
+{
+    // declared before dm, which draws the swarm from it
+    std::mt19937 gen;
+
+  public:
+    static constexpr float screen_width = 1920;
+    static constexpr float screen_height = 1080;
+
+    game(std::uint32_t seed,
+         int drones,
+         unsigned threads = 0,
+         double tick_rate = sim_clock::default_tick_rate);
+    game(const game&) = delete;
+    game& operator=(const game&) = delete;
+
+    // run one tick, returns the bullets that hit a drone in it
+    const std::vector<bullet_hit>& step(const tick_input& in);
+    // ticks run so far
+    std::uint64_t tick() const { return ticks; }
+    // hash of the simulation state, equal runs hash equal
+    std::uint64_t checksum() const;
+
+    ship s{ ship_param{ .x = screen_width / 2, .y = screen_height / 2 } };
+    ship y{ ship_param{} };
+    turret t;
+    Camera2D camera{};
+    drone_manager dm;
+    // two turrets firing every 10 ms for a bullet's 5 s
+    particle_pool bullets{ 1024 };
+    particle_pool explosions{ 4096 };
+    bool debug{ false };
+
+  private:
+    friend void save_snapshot(const std::string&, const game&, bool);
+    friend void load_snapshot(const snapshot&, game&);
+
+    collision_stage collisions;
+    std::vector<Vector2> bullet_from;
+    std::uint32_t fire_ticks;
+    std::uint32_t bullet_ticks;
+    std::uint32_t explosion_ticks;
+    std::uint64_t next_fire{ 0 };
+    std::uint64_t ticks{ 0 };
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <raylib.h>
+
+#include "util.h"
+
+/*
+fixed capacity pool of short lived effects (bullets, explosions) kept as
+structure-of-arrays. lifetimes count simulation ticks, so nothing here reads
+a clock, and expired particles are swap-removed: the pool stays dense and
+never allocates after construction, however many a fight spawns
+*/
+struct particle_pool
+{
+    yhl_util::aligned_vector<Vector2> pos;
+    yhl_util::aligned_vector<Vector2> vel;
+    // ticks lived and ticks to live
+    yhl_util::aligned_vector<std::uint32_t> age;
+    yhl_util::aligned_vector<std::uint32_t> lifetime;
+
+    explicit particle_pool(std::size_t capacity);
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return pos.size(); }
+
+    // false, and nothing spawned, when the pool is full
+    bool spawn(Vector2 p, Vector2 v, std::uint32_t ticks);
+    // move every particle by its velocity and age it one tick
+    void advance();
+    // drop particle i at the next expire()
+    void kill(std::size_t i) { age[i] = lifetime[i]; }
+    // swap-remove every particle that has lived out its lifetime
+    void expire();
+    /*
+    the first n slots (n <= capacity) become the live particles, for
+    filling the arrays directly, as loading a snapshot does
+    */
+    void resize(std::size_t n) { count = n; }
+    // how far particle i is through its life, 0 at spawn and 1 at expiry
+    float progress(std::size_t i) const
+    {
+        return float(age[i]) / float(lifetime[i]);
+    }
+
+  private:
+    std::size_t count{ 0 };
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+scoped zone profiler. GAME7_ZONE("name") times the rest of the enclosing
+scope into a ring buffer owned by the calling thread, so zones on the
+workers of a parallel_for never contend. a full ring overwrites its oldest
+zones.
+
+zones only record while the profiler is enabled, a disabled zone costs a
+load and a branch. built without GAME7_PROFILE (cmake -DGAME7_PROFILE=OFF)
+GAME7_ZONE expands to nothing and there is no cost at all.
+
+zone names must be string literals, only the pointer is kept. read the
+results (summary, write_chrome_trace) while no zones are running, between
+frames or after the run
+*/
+namespace yhl_util::profiler {
+
+using clock = std::chrono::steady_clock;
+
+void
+enable(bool state);
+bool
+enabled();
+// drop every recorded zone
+void
+reset();
+
+class zone
+{
+  public:
+    explicit zone(const char* name)
+      : name(enabled() ? name : nullptr)
+    {
+        if (this->name) {
+            start = clock::now();
+        }
+    }
+    ~zone();
+    zone(const zone&) = delete;
+    zone& operator=(const zone&) = delete;
+
+  private:
+    const char* name;
+    clock::time_point start;
+};
+
+// timings of one zone name over everything recorded, in microseconds
+struct phase_stats
+{
+    std::string name;
+    std::uint64_t count{ 0 };
+    double p50{ 0 };
+    double p99{ 0 };
+    double max{ 0 };
+    double total{ 0 };
+};
+
+// one entry per zone name, by total time spent, largest first
+std::vector<phase_stats>
+summary();
+// summary() as a table
+void
+write_summary(std::ostream& out);
+/*
+every recorded zone as a chrome://tracing (or perfetto) json file, one
+track per thread. false if the file can't be written
+*/
+bool
+write_chrome_trace(const std::string& path);
+
+};
+
+#define GAME7_ZONE_CAT2(a, b) a##b
+#define GAME7_ZONE_CAT(a, b) GAME7_ZONE_CAT2(a, b)
+#ifdef GAME7_PROFILE
+#define GAME7_ZONE(name)                                                       \
+    ::yhl_util::profiler::zone GAME7_ZONE_CAT(game7_zone_, __LINE__)           \
+    {                                                                          \
+        name                                                                   \
+    }
+#else
+#define GAME7_ZONE(name) static_cast<void>(0)
+#endif
@@ -1,10 +1,16 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <concepts>
-#include <memory>
+#include <cstdint>
 #include <raylib.h>
+#include <span>
+#include <string>
 #include <type_traits>
 
+#include "profiler.h"
+#include "quantized.h"
 #include "util.h"
 #include <vector>
 namespace yhl_util {
@@ -14,7 +20,19 @@ concept has_pos = requires(T t) {
     { t.pos } -> std::same_as<Vector2&>;
 };
 
-template<has_pos T>
+/*
+entries of a quadtree keep their position as the coordinates (C) or as 16
+bit codes over the tree's area, see quantizer
+*/
+template<typename P, typename C>
+concept entry_coordinate =
+  std::same_as<P, C> || std::same_as<P, std::int16_t>;
+
+/*
+C is the precision of the tree's area, the queries and the positions it is
+given, float to match the Vector2 positions of T
+*/
+template<has_pos T, std::floating_point C = float, entry_coordinate<C> P = C>
 class quadtree
 {
     /*
@@ -32,169 +50,693 @@ class quadtree
     2 - bottom right
     3 - bottom left
     */
-    // struct quadrant_map{
-    //     double x;
-    //     double y;
-    //     double w;
-    //     double h;
-    // };
-    std::array<std::unique_ptr<quadtree<T>>, 4> quadrants;
-    std::vector<typename std::vector<T>::iterator> elements;
+
+    /*
+    all nodes of a tree live in one arena (nodes) and reference each other
+    by index, the four children of a node are stored next to each other.
+    the elements of a leaf sit in fixed size blocks of a shared flat array,
+    chained when a leaf at the minimum size overflows. clear() only resets
+    the arena, so rebuilding a tree does not allocate once it is warm.
+
+    elements are indices into the caller's array of T, half the size of an
+    iterator and still meaningful after the array grows or is compacted.
+    a tree filled with rebuild() also remembers the slot of every element,
+    so move() can find it without a search. an element that stays inside
+    its leaf only has its position updated. one that leaves is taken out
+    and inserted again from the root, and the quads it left merge back
+    into their parent once they hold less than half the capacity. the
+    children of merged quads go on a free list for the next subdivide.
+
+    quantized entries (P = std::int16_t) take 8 bytes rather than 12, so a
+    walk over a leaf reads two thirds of the memory. one within a step of a
+    quad's edge can sort into the quad next door, so queries on a quantized
+    tree look a step further, and the centers of mass summarize() finds are
+    off by up to a step
+    */
+    struct entry
+    {
+        std::uint32_t element;
+        // position the element was inserted at
+        P x;
+        P y;
+    };
+    struct node
+    {
+        C x;
+        C y;
+        C w;
+        C h;
+        std::int32_t first_child{ -1 };
+        std::int32_t parent{ -1 };
+        // most recently started block, older blocks are always full
+        std::int32_t block{ -1 };
+        std::uint32_t count{ 0 };
+        // aggregates of everything below the node, filled in by summarize()
+        float mass{ 0 };
+        float cx{ 0 };
+        float cy{ 0 };
+    };
+    std::vector<node> nodes;
+    std::vector<entry> entries;
+    std::vector<std::int32_t> next_block;
+    std::vector<std::int32_t> free_blocks;
+    std::vector<entry> moving;
+    // first of four children no longer in use
+    std::vector<std::int32_t> free_quads;
+    // leaf every block belongs to
+    std::vector<std::int32_t> block_owner;
+    // entries slot of every element, filled by rebuild()
+    std::vector<std::int32_t> slots;
     std::size_t capacity;
-    double min_w{ 1920.f / 64 };
-    double min_h{ 1080.f / 64 };
+    C min_w{ 1920.f / 64 };
+    C min_h{ 1080.f / 64 };
+    // codes of the entry positions over the area, when they are quantized
+    static constexpr bool quantized = std::same_as<P, std::int16_t>;
+    quantizer<C> codes;
+
+    P pack_x(C v) const
+    {
+        if constexpr (quantized) {
+            return codes.encode_x(v);
+        } else {
+            return v;
+        }
+    }
+    P pack_y(C v) const
+    {
+        if constexpr (quantized) {
+            return codes.encode_y(v);
+        } else {
+            return v;
+        }
+    }
+    C unpack_x(P v) const
+    {
+        if constexpr (quantized) {
+            return codes.decode_x(v);
+        } else {
+            return v;
+        }
+    }
+    C unpack_y(P v) const
+    {
+        if constexpr (quantized) {
+            return codes.decode_y(v);
+        } else {
+            return v;
+        }
+    }
+    // how much further than asked the queries look, to find the elements
+    // that sorted into the quad next door
+    C reach() const
+    {
+        if constexpr (quantized) {
+            return std::max(codes.step_x, codes.step_y);
+        } else {
+            return 0;
+        }
+    }
+
+    std::int32_t allocate_block();
+    void push_entry(std::int32_t n, const entry& e);
+    void remove_entry(std::int32_t n, std::int32_t slot);
+    void subdivide(std::int32_t n);
+    void merge_up(std::int32_t n);
+    void summarize_node(std::int32_t n, std::span<const T> items);
+    void draw_node(std::int32_t n) const;
+    std::int32_t quadrant_of(const node& nd, C x_, C y_) const;
+    std::int32_t quadrant_of(const node& nd, const entry& e) const;
+    template<typename F>
+    void for_each_entry(const node& nd, F&& f) const;
+    template<typename F>
+    void query_node(std::int32_t n,
+                    const basic_rectangle<C>& area,
+                    F& visit,
+                    bool debug) const;
+    template<typename Accept, typename Far, typename Near>
+    void approximate_node(std::int32_t n,
+                          C px,
+                          C py,
+                          C radius,
+                          C theta,
+                          Accept& accept,
+                          Far& far,
+                          Near& near) const;
 
   public:
-    double x;
-    double y;
-    double w;
-    double h;
-    static Camera2D* c;
-    quadtree(double x, double y, double w, double h);
-    void insert(std::vector<T>::iterator element, double x_, double y_);
-    void query(double,
-               double,
-               double,
-               double,
-               std::vector<typename std::vector<T>::iterator>&,
+    C x;
+    C y;
+    C w;
+    C h;
+    /*
+    the tree indexes world space. it covers x, y, w, h until the next clear,
+    elements outside it land in the nearest edge quad
+    */
+    quadtree(C x, C y, C w, C h);
+    void insert(std::uint32_t element, C x_, C y_);
+    /*
+    clear and insert every item at its current position, keeping track of
+    them for move() and swap_remove()
+    */
+    void rebuild(std::span<const T> items);
+    /*
+    relocate an element of the last rebuild() to (x_, y_), touching the
+    tree only if it crosses into another leaf
+    */
+    void move(std::uint32_t element, C x_, C y_);
+    /*
+    mirror of a swap-and-pop on the items: element leaves the tree and the
+    last element is renamed to it
+    */
+    void swap_remove(std::uint32_t element, std::uint32_t last);
+    void query(C,
+               C,
+               C,
+               C,
+               std::vector<std::uint32_t>&,
                bool debug = false) const;
+    /*
+    calls visit(element) for every element in the quads overlapping the area,
+    without materializing the results
+    */
+    template<typename F>
+    void query(C, C, C, C, F&& visit) const;
+    /*
+    query into a per-thread scratch vector that is reused across calls. the
+    result is only valid until the next scratch query on the same thread
+    */
+    const std::vector<std::uint32_t>& query(C, C, C, C) const;
+    /*
+    total mass and center of mass of every node, for approximate(). call once
+    the tree is built over items, T needs a mass
+    */
+    void summarize(std::span<const T> items)
+        requires requires(T t) { float(t.mass); };
+    /*
+    barnes-hut walk over the elements within radius of (px, py). a node is
+    taken as a single body, far(cx, cy, mass) at its center of mass, when
+    (px, py) lies outside it, it is small for its distance (w / d < theta)
+    and accept(min_dist, max_dist) agrees for the distances between the
+    point and the node's area. all other elements are visited one by one
+    with near(element). needs summarize()
+    */
+    template<typename Accept, typename Far, typename Near>
+    void approximate(C px,
+                     C py,
+                     C radius,
+                     C theta,
+                     Accept&& accept,
+                     Far&& far,
+                     Near&& near) const;
+    // debug drawing, in world space (inside BeginMode2D)
     void draw() const;
     void clear();
+    // empty the tree and make it cover a new area
+    void clear(C x, C y, C w, C h);
 };
-template<has_pos T>
-quadtree<T>::quadtree(double x, double y, double w, double h)
-  : x(x)
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+quadtree<T, C, P>::quadtree(C x, C y, C w, C h)
+  : capacity(50)
+  , x(x)
   , y(y)
   , w(w)
   , h(h)
-  , capacity(50)
-{
-}
-
-template<has_pos T>
-void
-quadtree<T>::query(double x_,
-                   double y_,
-                   double w_,
-                   double h_,
-                   std::vector<typename std::vector<T>::iterator>& res,
-                   bool debug) const
-{
-    if (!yhl_util::check_collision(
-          yhl_util::Rectangle{
-            .x = x_,
-            .y = y_,
-            .width = w_,
-            .height = h_,
-          },
-          yhl_util::Rectangle{
-            .x = x,
-            .y = y,
-            .width = w,
-            .height = h,
-          })) {
-        return;
+{
+    nodes.emplace_back(node{ .x = x, .y = y, .w = w, .h = h });
+    codes = quantizer<C>::covering(x, y, w, h);
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+std::int32_t
+quadtree<T, C, P>::allocate_block()
+{
+    if (!free_blocks.empty()) {
+        auto b = free_blocks.back();
+        free_blocks.pop_back();
+        return b;
     }
-    if (debug) {
-        DrawRectangleLinesEx(::Rectangle{ x, y, w, h }, 5, RED);
-    }
-
-    if (elements.size() > 0) {
-        for (auto e : elements) {
-            if (debug) {
-                if (c) {
-                    auto ep = GetWorldToScreen2D(e->pos, *c);
-                    DrawLineV(ep, Vector2{ x, y }, RED);
-                    std::string pos = "(" + std::to_string(ep.x) + ", " +
-                                      std::to_string(ep.y) + ")";
-                    DrawText(pos.c_str(), ep.x, ep.y, 10, RED);
-                }
-            }
-            res.emplace_back(e);
+    auto b = std::int32_t(next_block.size());
+    next_block.emplace_back(-1);
+    entries.resize(entries.size() + capacity);
+    return b;
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::push_entry(std::int32_t n, const entry& e)
+{
+    auto slot = nodes[n].count % capacity;
+    if (slot == 0) {
+        auto b = allocate_block();
+        next_block[b] = nodes[n].block;
+        block_owner.resize(next_block.size());
+        block_owner[b] = n;
+        nodes[n].block = b;
+    }
+    auto at = nodes[n].block * capacity + slot;
+    entries[at] = e;
+    nodes[n].count++;
+    if (!slots.empty()) {
+        slots[e.element] = std::int32_t(at);
+    }
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::remove_entry(std::int32_t n, std::int32_t slot)
+{
+    // the last entry of the leaf takes the hole
+    auto& nd = nodes[n];
+    auto fill = (nd.count - 1) % capacity + 1;
+    auto last = std::int32_t(nd.block * capacity + fill - 1);
+    if (slot != last) {
+        entries[slot] = entries[last];
+        if (!slots.empty()) {
+            slots[entries[slot].element] = slot;
         }
     }
-    if (quadrants[0]) {
-        for (auto& q : quadrants) {
-            q->query(x_, y_, w_, h_, res, debug);
+    nd.count--;
+    if (fill == 1) {
+        free_blocks.emplace_back(nd.block);
+        nd.block = next_block[nd.block];
+    }
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+template<typename F>
+void
+quadtree<T, C, P>::for_each_entry(const node& nd, F&& f) const
+{
+    std::size_t fill = nd.count == 0 ? 0 : (nd.count - 1) % capacity + 1;
+    for (auto b = nd.block; b >= 0; b = next_block[b]) {
+        auto const* first = &entries[b * capacity];
+        for (std::size_t i = 0; i < fill; i++) {
+            f(first[i]);
         }
+        fill = capacity;
     }
 }
 
-template<has_pos T>
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+std::int32_t
+quadtree<T, C, P>::quadrant_of(const node& nd, C x_, C y_) const
+{
+    if (x_ <= nd.x + nd.w / 2) {
+        return y_ <= nd.y + nd.h / 2 ? 0 : 3;
+    }
+    return y_ <= nd.y + nd.h / 2 ? 1 : 2;
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+std::int32_t
+quadtree<T, C, P>::quadrant_of(const node& nd, const entry& e) const
+{
+    if constexpr (quantized) {
+        // the halves meet about on a step boundary, compared as codes the
+        // entry goes where its exact position would, give or take a step
+        auto mx = pack_x(nd.x + nd.w / 2);
+        auto my = pack_y(nd.y + nd.h / 2);
+        if (e.x <= mx) {
+            return e.y <= my ? 0 : 3;
+        }
+        return e.y <= my ? 1 : 2;
+    } else {
+        return quadrant_of(nd, e.x, e.y);
+    }
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::subdivide(std::int32_t n)
+{
+    auto const p = nodes[n];
+    std::int32_t first;
+    if (free_quads.empty()) {
+        first = std::int32_t(nodes.size());
+        nodes.resize(nodes.size() + 4);
+    } else {
+        first = free_quads.back();
+        free_quads.pop_back();
+    }
+    nodes[n].first_child = first;
+    auto hw = p.w / 2;
+    auto hh = p.h / 2;
+    nodes[first] = node{ .x = p.x, .y = p.y, .w = hw, .h = hh, .parent = n };
+    nodes[first + 1] =
+      node{ .x = p.x + hw, .y = p.y, .w = hw, .h = hh, .parent = n };
+    nodes[first + 2] =
+      node{ .x = p.x + hw, .y = p.y + hh, .w = hw, .h = hh, .parent = n };
+    nodes[first + 3] =
+      node{ .x = p.x, .y = p.y + hh, .w = hw, .h = hh, .parent = n };
+
+    // pushing into the children can grow entries, so move out of a copy
+    moving.clear();
+    for_each_entry(p, [&](const entry& e) { moving.emplace_back(e); });
+    for (auto const& e : moving) {
+        push_entry(first + quadrant_of(p, e), e);
+    }
+    for (auto b = p.block; b >= 0; b = next_block[b]) {
+        free_blocks.emplace_back(b);
+    }
+    nodes[n].block = -1;
+    nodes[n].count = 0;
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
 void
-quadtree<T>::insert(std::vector<T>::iterator element, double x_, double y_)
+quadtree<T, C, P>::merge_up(std::int32_t n)
 {
-    if (elements.size() >= capacity && w > min_w && h > min_h &&
-        !quadrants[0]) {
-        // initialize the sub-trees and insert everything
-        quadrants[0] = std::make_unique<quadtree<T>>(x, y, w / 2, h / 2);
-        quadrants[1] =
-          std::make_unique<quadtree<T>>(x + w / 2, y, w / 2, h / 2);
-        quadrants[2] =
-          std::make_unique<quadtree<T>>(x + w / 2, y + h / 2, w / 2, h / 2);
-        quadrants[3] =
-          std::make_unique<quadtree<T>>(x, y + h / 2, w / 2, h / 2);
-        for (auto i : elements) {
-            auto pos = i->pos;
-            if (c) {
-                pos = GetWorldToScreen2D(i->pos, *c);
+    for (; n >= 0; n = nodes[n].parent) {
+        auto first = nodes[n].first_child;
+        std::uint32_t total = 0;
+        for (std::int32_t i = 0; i < 4; i++) {
+            if (nodes[first + i].first_child >= 0) {
+                return;
             }
-            if (pos.x <= x + w / 2) {
-                if (pos.y <= y + h / 2) {
-                    quadrants[0]->insert(i, pos.x, pos.y);
-                } else {
-                    quadrants[3]->insert(i, pos.x, pos.y);
-                }
-            } else {
-                if (pos.y <= y + h / 2) {
-                    quadrants[1]->insert(i, pos.x, pos.y);
-                } else {
-                    quadrants[2]->insert(i, pos.x, pos.y);
-                }
+            total += nodes[first + i].count;
+        }
+        // half the capacity, so a drone going back and forth over a quad
+        // edge does not split and merge the quad every frame
+        if (total >= capacity / 2) {
+            return;
+        }
+        moving.clear();
+        for (std::int32_t i = 0; i < 4; i++) {
+            auto& ch = nodes[first + i];
+            for_each_entry(ch, [&](const entry& e) { moving.emplace_back(e); });
+            for (auto b = ch.block; b >= 0; b = next_block[b]) {
+                free_blocks.emplace_back(b);
             }
+            ch.block = -1;
+            ch.count = 0;
+        }
+        nodes[n].first_child = -1;
+        free_quads.emplace_back(first);
+        for (auto const& e : moving) {
+            push_entry(n, e);
         }
-        elements.clear();
-        return;
     }
-    if (!quadrants[0]) {
-        elements.emplace_back(element);
-    } else {
-        if (x_ <= x + w / 2) {
-            if (y_ <= y + h / 2) {
-                quadrants[0]->insert(element, x_, y_);
-            } else {
-                quadrants[3]->insert(element, x_, y_);
-            }
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::insert(std::uint32_t element, C x_, C y_)
+{
+    std::int32_t n = 0;
+    while (true) {
+        auto const& nd = nodes[n];
+        if (nd.first_child >= 0) {
+            n = nd.first_child + quadrant_of(nd, x_, y_);
+        } else if (nd.count >= capacity && nd.w > min_w && nd.h > min_h) {
+            subdivide(n);
         } else {
-            if (y_ <= y + h / 2) {
-                quadrants[1]->insert(element, x_, y_);
-            } else {
-                quadrants[2]->insert(element, x_, y_);
-            }
+            break;
+        }
+    }
+    push_entry(n, entry{ element, pack_x(x_), pack_y(y_) });
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::rebuild(std::span<const T> items)
+{
+    GAME7_ZONE("quadtree rebuild");
+    clear();
+    slots.assign(items.size(), -1);
+    for (std::size_t i = 0; i < items.size(); i++) {
+        insert(std::uint32_t(i), items[i].pos.x, items[i].pos.y);
+    }
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::move(std::uint32_t element, C x_, C y_)
+{
+    auto slot = slots[element];
+    auto leaf = block_owner[slot / capacity];
+    auto const& nd = nodes[leaf];
+    // strictly inside the leaf, the root would lead back to it
+    if (x_ > nd.x && x_ < nd.x + nd.w && y_ > nd.y && y_ < nd.y + nd.h) {
+        entries[slot].x = pack_x(x_);
+        entries[slot].y = pack_y(y_);
+        return;
+    }
+    remove_entry(leaf, slot);
+    insert(element, x_, y_);
+    if (nodes[leaf].parent >= 0) {
+        merge_up(nodes[leaf].parent);
+    }
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::swap_remove(std::uint32_t element, std::uint32_t last)
+{
+    auto slot = slots[element];
+    auto leaf = block_owner[slot / capacity];
+    remove_entry(leaf, slot);
+    if (nodes[leaf].parent >= 0) {
+        merge_up(nodes[leaf].parent);
+    }
+    if (element != last) {
+        slots[element] = slots[last];
+        entries[slots[element]].element = element;
+    }
+    slots.pop_back();
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+template<typename F>
+void
+quadtree<T, C, P>::query_node(std::int32_t n,
+                              const basic_rectangle<C>& area,
+                              F& visit,
+                              bool debug) const
+{
+    auto const& nd = nodes[n];
+    if (!yhl_util::check_collision(area,
+                                   basic_rectangle<C>{
+                                     .x = nd.x,
+                                     .y = nd.y,
+                                     .width = nd.w,
+                                     .height = nd.h,
+                                   })) {
+        return;
+    }
+    if (debug) {
+        DrawRectangleLinesEx(
+          ::Rectangle{ float(nd.x), float(nd.y), float(nd.w), float(nd.h) },
+          5,
+          RED);
+    }
+    for_each_entry(nd, [&](const entry& e) {
+        if (debug) {
+            Vector2 ep{ float(unpack_x(e.x)), float(unpack_y(e.y)) };
+            DrawLineV(ep, Vector2{ float(nd.x), float(nd.y) }, RED);
+            // appended piece by piece, gcc 12 sees overlapping copies in
+            // "(" + std::string
+            std::string pos{ "(" };
+            pos += std::to_string(ep.x);
+            pos += ", ";
+            pos += std::to_string(ep.y);
+            pos += ")";
+            DrawText(pos.c_str(), ep.x, ep.y, 10, RED);
+        }
+        visit(e.element);
+    });
+    if (nd.first_child >= 0) {
+        for (std::int32_t i = 0; i < 4; i++) {
+            query_node(nd.first_child + i, area, visit, debug);
         }
     }
 }
 
-template<has_pos T>
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::query(C x_,
+                         C y_,
+                         C w_,
+                         C h_,
+                         std::vector<std::uint32_t>& res,
+                         bool debug) const
+{
+    auto visit = [&](std::uint32_t e) { res.emplace_back(e); };
+    query_node(0,
+               basic_rectangle<C>{
+                 .x = x_ - reach(),
+                 .y = y_ - reach(),
+                 .width = w_ + 2 * reach(),
+                 .height = h_ + 2 * reach(),
+               },
+               visit,
+               debug);
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+template<typename F>
 void
-quadtree<T>::draw() const
+quadtree<T, C, P>::query(C x_, C y_, C w_, C h_, F&& visit) const
 {
-    if (!quadrants[0]) {
-        DrawRectangleLines(x, y, w, h, WHITE);
+    query_node(0,
+               basic_rectangle<C>{
+                 .x = x_ - reach(),
+                 .y = y_ - reach(),
+                 .width = w_ + 2 * reach(),
+                 .height = h_ + 2 * reach(),
+               },
+               visit,
+               false);
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+const std::vector<std::uint32_t>&
+quadtree<T, C, P>::query(C x_, C y_, C w_, C h_) const
+{
+    thread_local std::vector<std::uint32_t> scratch;
+    scratch.clear();
+    query(x_, y_, w_, h_, [&](std::uint32_t e) { scratch.emplace_back(e); });
+    return scratch;
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::summarize(std::span<const T> items)
+    requires requires(T t) { float(t.mass); }
+{
+    GAME7_ZONE("quadtree summarize");
+    summarize_node(0, items);
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::summarize_node(std::int32_t n, std::span<const T> items)
+{
+    auto& nd = nodes[n];
+    double mass = 0;
+    double mx = 0;
+    double my = 0;
+    if (nd.first_child < 0) {
+        for_each_entry(nd, [&](const entry& e) {
+            double m = items[e.element].mass;
+            mass += m;
+            mx += m * unpack_x(e.x);
+            my += m * unpack_y(e.y);
+        });
     } else {
-        for (auto const& q : quadrants) {
-            q->draw();
+        for (std::int32_t i = 0; i < 4; i++) {
+            summarize_node(nd.first_child + i, items);
+            auto const& ch = nodes[nd.first_child + i];
+            mass += ch.mass;
+            mx += double(ch.mass) * ch.cx;
+            my += double(ch.mass) * ch.cy;
         }
     }
+    nd.mass = float(mass);
+    nd.cx = mass > 0 ? float(mx / mass) : float(nd.x + nd.w / 2);
+    nd.cy = mass > 0 ? float(my / mass) : float(nd.y + nd.h / 2);
 }
-template<has_pos T>
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+template<typename Accept, typename Far, typename Near>
 void
-quadtree<T>::clear()
+quadtree<T, C, P>::approximate_node(std::int32_t n,
+                                    C px,
+                                    C py,
+                                    C radius,
+                                    C theta,
+                                    Accept& accept,
+                                    Far& far,
+                                    Near& near) const
 {
-    for (auto& q : quadrants) {
-        q.release();
+    auto const& nd = nodes[n];
+    if (nd.mass <= 0) {
+        return;
+    }
+    // nearest and furthest point of the node from p
+    C nx = std::clamp(px, nd.x, nd.x + nd.w) - px;
+    C ny = std::clamp(py, nd.y, nd.y + nd.h) - py;
+    C fx = std::max(std::abs(px - nd.x), std::abs(px - nd.x - nd.w));
+    C fy = std::max(std::abs(py - nd.y), std::abs(py - nd.y - nd.h));
+    C min_dist = std::sqrt(nx * nx + ny * ny);
+    C max_dist = std::sqrt(fx * fx + fy * fy);
+    if (min_dist >= radius) {
+        return;
+    }
+    C dx = nd.cx - px;
+    C dy = nd.cy - py;
+    C d = std::sqrt(dx * dx + dy * dy);
+    if (min_dist > 0 && nd.w < theta * d && accept(min_dist, max_dist)) {
+        far(nd.cx, nd.cy, nd.mass);
+        return;
+    }
+    for_each_entry(nd, [&](const entry& e) { near(e.element); });
+    if (nd.first_child >= 0) {
+        for (std::int32_t i = 0; i < 4; i++) {
+            approximate_node(
+              nd.first_child + i, px, py, radius, theta, accept, far, near);
+        }
     }
-    elements.clear();
 }
 
-};
\ No newline at end of file
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+template<typename Accept, typename Far, typename Near>
+void
+quadtree<T, C, P>::approximate(C px,
+                               C py,
+                               C radius,
+                               C theta,
+                               Accept&& accept,
+                               Far&& far,
+                               Near&& near) const
+{
+    approximate_node(
+      0, px, py, radius + reach(), theta, accept, far, near);
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::draw_node(std::int32_t n) const
+{
+    auto const& nd = nodes[n];
+    if (nd.first_child < 0) {
+        DrawRectangleLines(nd.x, nd.y, nd.w, nd.h, WHITE);
+        return;
+    }
+    for (std::int32_t i = 0; i < 4; i++) {
+        draw_node(nd.first_child + i);
+    }
+}
+
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::draw() const
+{
+    draw_node(0);
+}
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::clear(C x_, C y_, C w_, C h_)
+{
+    x = x_;
+    y = y_;
+    w = w_;
+    h = h_;
+    clear();
+}
+template<has_pos T, std::floating_point C, entry_coordinate<C> P>
+void
+quadtree<T, C, P>::clear()
+{
+    nodes.resize(1);
+    nodes[0] = node{ .x = x, .y = y, .w = w, .h = h };
+    codes = quantizer<C>::covering(x, y, w, h);
+    entries.clear();
+    next_block.clear();
+    free_blocks.clear();
+    free_quads.clear();
+    block_owner.clear();
+    slots.clear();
+}
+
+};
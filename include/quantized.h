@@ -0,0 +1,58 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+
+namespace yhl_util {
+
+/*
+positions as 16 bit codes relative to an area, a quarter of the bytes of a
+pair of doubles and half those of a float pair. the area x, y, w, h is cut
+into 65536 steps along each side and a coordinate becomes the step it lies
+at, rounded up, so a code is exact to one step: w / 65536, 1/32 of a unit
+for a 2048 wide world chunk. coordinates outside the area clamp to its edge.
+an area narrower than min_side along a side, down to a single point, is
+taken as min_side wide there.
+
+rounding up keeps comparisons with a step boundary b exact: x <= b exactly
+when encode_x(x) <= encode_x(b). the quadrant edges of a quadtree over the
+area are step boundaries for its first 16 levels, up to the rounding of
+computing them
+*/
+template<std::floating_point C = float>
+struct quantizer
+{
+    C x{ 0 };
+    C y{ 0 };
+    C step_x{ 1 };
+    C step_y{ 1 };
+
+    static constexpr std::int32_t steps = 65536;
+    static constexpr C min_side = C(1) / 64;
+
+    static quantizer covering(C x, C y, C w, C h)
+    {
+        return { x,
+                 y,
+                 std::max(w, min_side) / steps,
+                 std::max(h, min_side) / steps };
+    }
+
+    std::int16_t encode_x(C v) const { return encode(v, x, step_x); }
+    std::int16_t encode_y(C v) const { return encode(v, y, step_y); }
+    C decode_x(std::int16_t q) const { return x + step_x * (q + 32768); }
+    C decode_y(std::int16_t q) const { return y + step_y * (q + 32768); }
+
+  private:
+    static std::int16_t encode(C v, C origin, C step)
+    {
+        // in double, so a float area keeps its steps exact far from zero
+        auto k = std::ceil((double(v) - double(origin)) / double(step));
+        // written so a nan lands on the first step too
+        k = k > 0 ? std::min(k, double(steps - 1)) : 0.0;
+        return std::int16_t(std::int32_t(k) - 32768);
+    }
+};
+
+};
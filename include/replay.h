@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "game.h"
+
+/*
+replay log: what a game was built from and the input of every tick it ran,
+enough to run the same simulation again. little-endian whatever the host:
+
+    header  "G7RP", u32 version, u32 seed, u32 drones, f64 tick rate,
+            u8 simd level, u8 broadphase
+    runs    u32 ticks, f32 mouse x, f32 mouse y, f32 wheel, u8 buttons,
+            u8 keys
+
+a run is one input held for that many ticks in a row, so an idle player
+costs one record rather than one per tick.
+
+the simd kernels add the forces up in different orders and precisions, and
+so do the broadphases, so a log keeps the ones it was recorded with and a
+replay runs with them too
+*/
+struct replay_header
+{
+    static constexpr std::uint32_t current_version = 2;
+
+    std::uint32_t version{ current_version };
+    std::uint32_t seed{ 0 };
+    std::uint32_t drones{ 0 };
+    double tick_rate{ sim_clock::default_tick_rate };
+    simd_level simd{ simd_level::scalar };
+    // drone_manager's own default
+    broadphase index{ broadphase::grid };
+};
+
+/*
+set up the kernels and g's broadphase as the log was recorded, before its
+first tick. false if this cpu lacks the recorded simd level: the replay runs
+on the best one it has and may not end where the recording did
+*/
+bool
+use_recorded_setup(const replay_header& header, game& g);
+
+class replay_writer
+{
+  public:
+    // throws std::runtime_error if the file can't be written
+    replay_writer(const std::string& path, const replay_header& header);
+    // writes the run in progress and closes the file
+    ~replay_writer();
+    replay_writer(const replay_writer&) = delete;
+    replay_writer& operator=(const replay_writer&) = delete;
+
+    // the input of the next tick
+    void record(const tick_input& in);
+
+  private:
+    // writes the run in progress
+    void flush_run();
+    // runs written between two flushes of the file
+    static constexpr std::uint32_t flush_every = 64;
+
+    std::ofstream out;
+    tick_input held;
+    std::uint32_t run{ 0 };
+    std::uint32_t unflushed{ 0 };
+};
+
+class replay_reader
+{
+  public:
+    // throws std::runtime_error if the file is missing or not a replay log
+    explicit replay_reader(const std::string& path);
+
+    const replay_header& header() const { return head; }
+    // the input of the next tick, false once the log is done
+    bool next(tick_input& in);
+
+  private:
+    std::ifstream file;
+    replay_header head;
+    tick_input held;
+    std::uint32_t run{ 0 };
+};
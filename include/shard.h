@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <raylib.h>
+#include <vector>
+
+#include "drone_manager.h"
+
+/*
+the world cut into strips along x, one per shard: shard i owns the drones
+with cuts[i - 1] <= x < cuts[i], the first and the last strip reaching out
+forever
+*/
+struct shard_layout
+{
+    std::vector<float> cuts;
+
+    std::size_t count() const { return cuts.size() + 1; }
+    std::size_t owner(float x) const;
+    // where shard i's strip begins and ends, infinite at the edges
+    float lo(std::size_t i) const;
+    float hi(std::size_t i) const;
+};
+
+/*
+n strips with about as many of dm's drones each, the inner ones at least
+min_width wide so a drone's ghost is only ever needed next door. strips
+are pushed apart to make room, an inner strip may end up empty
+*/
+shard_layout
+split_swarm(const drone_manager& dm, std::size_t n, float min_width);
+
+struct shard_stats
+{
+    std::uint32_t shard{ 0 };
+    // owned when the run ended
+    std::uint64_t drones{ 0 };
+    // totals over the run
+    std::uint64_t ghosts_sent{ 0 };
+    std::uint64_t migrated{ 0 };
+    double tick_seconds{ 0 };
+    // building, sending, waiting for and unpacking the neighbors' drones
+    double exchange_seconds{ 0 };
+};
+
+/*
+run dm's swarm for ticks ticks in a worker process per strip of layout,
+forked from this one, each with a drone_manager of its own on threads
+threads, set up by setup (broadphase, lod, ...) and with dm's rules.
+
+the workers run in lockstep with the neighbors on either side, over a unix
+socket pair to each. after every tick a worker hands the drones that left
+its strip to the neighbor they went towards, keeping them as ghosts for
+the next tick, and sends both neighbors its drones within dm.reach() of
+their side as ghosts, which they tick with but do not move. a drone that
+crossed more than a whole strip in one tick is passed on the next. when
+the run ends dm holds every worker's drones, in shard order, and the
+returned stats are per shard.
+
+the forces on a drone are those of the single process run, but summed in
+another order, so the runs drift apart at float rounding.
+
+this forks: the calling process must not be running other threads, so
+build dm on a pool of one thread. throws std::runtime_error if a worker
+can't be started or fails
+*/
+std::vector<shard_stats>
+run_sharded(drone_manager& dm,
+            const shard_layout& layout,
+            std::uint64_t ticks,
+            Vector2 player_pos,
+            unsigned threads,
+            const std::function<void(drone_manager&)>& setup);
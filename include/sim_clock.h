@@ -0,0 +1,56 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+/*
+simulation time. the wall clock (steady_clock, so it never jumps) is read
+once per frame by begin_frame, and the elapsed time feeds a fixed timestep
+accumulator: the simulation runs whole ticks of dt() and everything in a
+frame sees the same tick and time, while render gets the part of a tick
+left over for interpolation
+*/
+class sim_clock
+{
+  public:
+    using clock = std::chrono::steady_clock;
+    static constexpr double default_tick_rate = 60;
+
+    /*
+    max_ticks caps the ticks one frame may run, so a long stall (a debugger,
+    a dragged window) drops time instead of spiralling
+    */
+    explicit sim_clock(double tick_rate = default_tick_rate,
+                       std::uint32_t max_ticks = 5);
+
+    // sample the wall clock, returns how many ticks to run this frame
+    std::uint32_t begin_frame();
+    // count one simulated tick, call after running it
+    void advance();
+
+    // ticks simulated so far
+    std::uint64_t tick() const { return ticks; }
+    // seconds per tick
+    double dt() const { return step; }
+    // wall time the last frame took, in seconds
+    double frame_dt() const { return frame; }
+    // fraction of a tick accumulated but not simulated yet, in [0, 1)
+    float alpha() const { return float(accumulator / step); }
+    // seconds of wall time until the next tick is due, as of begin_frame
+    double until_next() const { return std::max(0.0, step - accumulator); }
+    // the wall clock as sampled by the last begin_frame
+    clock::time_point now() const { return last; }
+    // whole ticks covering d, at least one
+    std::uint32_t ticks_for(std::chrono::duration<double> d) const;
+    static std::uint32_t ticks_for(std::chrono::duration<double> d,
+                                   double tick_rate);
+
+  private:
+    double rate;
+    double step;
+    std::uint32_t max_ticks;
+    clock::time_point last;
+    double accumulator{ 0 };
+    double frame{ 0 };
+    std::uint64_t ticks{ 0 };
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_snapshot.h"
+#include "game.h"
+#include "replay.h"
+#include "triple_buffer.h"
+
+/*
+runs a game on a thread of its own, so a frame is drawn while the next one
+is simulated. after every batch of ticks the simulation captures a
+frame_snapshot into a triple buffer; render takes the newest one whenever it
+starts a frame and draws between it and the one before, never waiting on
+the simulation and never seeing it half done.
+
+the render thread only touches the game through inspect(), which holds the
+simulation off between ticks
+*/
+class sim_thread
+{
+  public:
+    /*
+    paced runs tick_rate ticks a second by the wall clock, unpaced as fast
+    as it can. replay, when given, supplies the input instead of feed(), and
+    record logs the input of every tick. all of them must outlive the
+    thread
+    */
+    sim_thread(game& g,
+               double tick_rate,
+               bool paced,
+               replay_reader* replay = nullptr,
+               replay_writer* record = nullptr);
+    // stops the thread
+    ~sim_thread();
+    sim_thread(const sim_thread&) = delete;
+    sim_thread& operator=(const sim_thread&) = delete;
+
+    void start();
+    // finish the tick in progress and join
+    void stop();
+    // the replay ran out, the thread has stopped ticking
+    bool finished() const { return done.load(std::memory_order_acquire); }
+
+    /*
+    fold one frame's sampled input into what the next tick reads: held
+    buttons and the cursor are replaced, presses and wheel movement add up
+    until a tick takes them
+    */
+    void feed(const tick_input& frame);
+
+    // render side: take the newest snapshot, false if there is none
+    bool acquire();
+    // the snapshot acquire() took, and the one it replaced
+    const frame_snapshot& latest() const { return frames.front(); }
+    const frame_snapshot& previous() const { return prev; }
+    // how far render is from previous() to latest() at now, in [0, 1]
+    float alpha(sim_clock::clock::time_point now) const;
+
+    // fn(g) between two ticks
+    template<typename F>
+    void inspect(F&& fn)
+    {
+        std::lock_guard lock{ game_lock };
+        fn(g);
+    }
+
+  private:
+    void run();
+    tick_input take_input();
+
+    game& g;
+    double tick_rate;
+    bool paced;
+    replay_reader* replay;
+    replay_writer* record;
+
+    std::thread worker;
+    std::atomic<bool> stopping{ false };
+    std::atomic<bool> done{ false };
+    // held while a tick runs
+    std::mutex game_lock;
+    std::mutex input_lock;
+    tick_input pending;
+
+    yhl_util::triple_buffer<frame_snapshot> frames;
+    frame_snapshot prev;
+};
@@ -0,0 +1,214 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace yhl_util {
+
+/*
+32-bit name of a slot_map value: the slot in the low bits, the generation
+of the slot in the high bits
+*/
+struct slot_handle
+{
+    static constexpr std::uint32_t index_bits = 22;
+    static constexpr std::uint32_t index_mask = (1u << index_bits) - 1;
+
+    std::uint32_t value{ ~0u };
+
+    std::uint32_t index() const { return value & index_mask; }
+    std::uint32_t generation() const { return value >> index_bits; }
+    bool operator==(const slot_handle&) const = default;
+};
+
+template<typename T>
+class slot_map
+{
+    /*
+    generational slot map. the values are packed in one dense vector, so
+    they can be walked and indexed like a vector, while handles keep naming
+    the same value whatever moves around in it. erasing swaps the last value
+    into the hole and bumps the generation of the freed slot, so stale
+    handles to it are caught instead of reaching whatever moves in next
+    */
+    struct slot
+    {
+        // dense position of the value, or the next free slot
+        std::uint32_t target;
+        std::uint32_t generation{ 0 };
+    };
+    static constexpr std::uint32_t none = ~0u;
+    static constexpr std::uint32_t generation_mask =
+      (1u << (32 - slot_handle::index_bits)) - 1;
+
+    std::vector<T> dense;
+    // slot of every dense value
+    std::vector<std::uint32_t> owners;
+    std::vector<slot> slots;
+    std::uint32_t free_head{ none };
+
+  public:
+    // slots a handle can name, so values held at once
+    static constexpr std::size_t max_size = slot_handle::index_mask + 1;
+
+    // throws std::length_error past max_size values
+    slot_handle insert(const T& value);
+    // no-op for a stale handle
+    void erase(slot_handle h);
+    // erase the value at a dense position, the last value takes its place
+    void erase_at(std::size_t i);
+
+    // nullptr once the value is erased
+    T* get(slot_handle h);
+    const T* get(slot_handle h) const;
+    bool contains(slot_handle h) const { return get(h) != nullptr; }
+    slot_handle handle_at(std::size_t i) const;
+
+    std::size_t size() const { return dense.size(); }
+    bool empty() const { return dense.empty(); }
+    void clear();
+    /*
+    n value-initialized values in place of the current ones, held by slots
+    0 to n - 1 in order, to be filled in bulk through the dense values.
+    handles from before go stale as with clear(). throws std::length_error
+    past max_size
+    */
+    void reset(std::size_t n);
+    // room for n values, so inserting up to n does not reallocate
+    void reserve(std::size_t n);
+
+    T& operator[](std::size_t i) { return dense[i]; }
+    const T& operator[](std::size_t i) const { return dense[i]; }
+    T* begin() { return dense.data(); }
+    T* end() { return dense.data() + dense.size(); }
+    const T* begin() const { return dense.data(); }
+    const T* end() const { return dense.data() + dense.size(); }
+    // the dense values, in the order erase_at and the indices use
+    const std::vector<T>& values() const { return dense; }
+};
+
+template<typename T>
+slot_handle
+slot_map<T>::insert(const T& value)
+{
+    std::uint32_t s;
+    if (free_head != none) {
+        s = free_head;
+        free_head = slots[s].target;
+    } else {
+        if (slots.size() == max_size) {
+            throw std::length_error("slot_map: out of handle index bits");
+        }
+        s = std::uint32_t(slots.size());
+        slots.emplace_back();
+    }
+    slots[s].target = std::uint32_t(dense.size());
+    dense.emplace_back(value);
+    owners.emplace_back(s);
+    return handle_at(dense.size() - 1);
+}
+
+template<typename T>
+void
+slot_map<T>::erase(slot_handle h)
+{
+    if (contains(h)) {
+        erase_at(slots[h.index()].target);
+    }
+}
+
+template<typename T>
+void
+slot_map<T>::erase_at(std::size_t i)
+{
+    auto s = owners[i];
+    auto last = dense.size() - 1;
+    if (i != last) {
+        dense[i] = std::move(dense[last]);
+        owners[i] = owners[last];
+        slots[owners[i]].target = std::uint32_t(i);
+    }
+    dense.pop_back();
+    owners.pop_back();
+    slots[s].generation = (slots[s].generation + 1) & generation_mask;
+    slots[s].target = free_head;
+    free_head = s;
+}
+
+template<typename T>
+T*
+slot_map<T>::get(slot_handle h)
+{
+    auto s = h.index();
+    if (s >= slots.size() || slots[s].generation != h.generation() ||
+        owners.size() <= slots[s].target || owners[slots[s].target] != s) {
+        return nullptr;
+    }
+    return &dense[slots[s].target];
+}
+
+template<typename T>
+const T*
+slot_map<T>::get(slot_handle h) const
+{
+    return const_cast<slot_map*>(this)->get(h);
+}
+
+template<typename T>
+slot_handle
+slot_map<T>::handle_at(std::size_t i) const
+{
+    auto s = owners[i];
+    return slot_handle{ (slots[s].generation << slot_handle::index_bits) | s };
+}
+
+template<typename T>
+void
+slot_map<T>::clear()
+{
+    // every live slot goes back on the free list a generation later
+    for (auto s : owners) {
+        slots[s].generation = (slots[s].generation + 1) & generation_mask;
+        slots[s].target = free_head;
+        free_head = s;
+    }
+    dense.clear();
+    owners.clear();
+}
+
+template<typename T>
+void
+slot_map<T>::reset(std::size_t n)
+{
+    if (n > max_size) {
+        throw std::length_error("slot_map: out of handle index bits");
+    }
+    clear();
+    if (slots.size() < n) {
+        slots.resize(n);
+    }
+    dense.assign(n, T{});
+    owners.resize(n);
+    for (std::uint32_t s = 0; s < n; s++) {
+        slots[s].target = s;
+        owners[s] = s;
+    }
+    // the rest stay free, their generations as clear() left them
+    free_head = none;
+    for (auto s = std::uint32_t(slots.size()); s-- > n;) {
+        slots[s].target = free_head;
+        free_head = s;
+    }
+}
+
+template<typename T>
+void
+slot_map<T>::reserve(std::size_t n)
+{
+    dense.reserve(n);
+    owners.reserve(n);
+    slots.reserve(n);
+}
+
+};
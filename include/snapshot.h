@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "drone_manager.h"
+#include "game.h"
+
+/*
+snapshot: the state of a swarm, or of a whole game, in one file laid out to
+be mapped and used in place. every field of every species, pool or ship is
+its own array, written with one write and read without parsing. loading
+still costs a pass per drone: a species' slot map is sized once and its
+columns are copied into the drones, a few loads and stores each:
+
+    header  "G7SN", u32 version, u32 arrays, u32 reserved, u64 tick
+    table   per array: u32 section, u32 field, u32 element size,
+            u32 reserved, u64 count, u64 offset
+    data    the arrays, each starting on a 64 byte boundary
+
+everything is little-endian. the arrays are stored as the host keeps them,
+so only little-endian hosts save and load snapshots. a section a snapshot
+lacks loads as empty, so a game can start from a swarm-only snapshot.
+
+a snapshot saved quantized keeps the drones' positions as 16 bit codes over
+the bounding box of their species, a quantizer<float> in the section's frame
+field, instead of x and y. it takes 4 bytes less per drone, and the drones
+load up to a step, box / 65536, from where they were. it is not loaded bit
+for bit, whatever the broadphase.
+
+a grid run resumed from a snapshot is bit for bit the run that never
+stopped. the quadtree is rebuilt on load rather than saved, and visits
+neighbors in a different order than the incrementally updated tree did, so
+a resumed quadtree run only agrees up to float rounding
+*/
+enum class snapshot_section : std::uint32_t
+{
+    green,
+    red,
+    yellow,
+    bullets,
+    explosions,
+    ships,
+    game,
+};
+
+// fields of the drone sections, the arrays of drone_store and the lod state
+enum class drone_field : std::uint32_t
+{
+    x,
+    y,
+    vx,
+    vy,
+    mass,
+    health,
+    asleep,
+    stay_awake,
+    // x and y of a quantized snapshot, and the quantizer of their codes
+    qx,
+    qy,
+    frame,
+};
+
+// fields of the bullets and explosions sections, those of particle_pool
+enum class particle_field : std::uint32_t
+{
+    pos,
+    vel,
+    age,
+    lifetime,
+};
+
+// fields of the ships section, the player's ship first
+enum class ship_field : std::uint32_t
+{
+    x,
+    y,
+    // radians, as a double
+    angle,
+};
+
+// fields of the game section, one element each
+enum class game_field : std::uint32_t
+{
+    next_fire,
+    zoom,
+    debug,
+    // mounting point of the player's ship the turret sits on, or -1
+    mount,
+};
+
+class snapshot
+{
+  public:
+    static constexpr std::uint32_t current_version = 1;
+
+    // maps the file. throws std::runtime_error if it isn't a snapshot
+    explicit snapshot(const std::string& path);
+    ~snapshot();
+    snapshot(const snapshot&) = delete;
+    snapshot& operator=(const snapshot&) = delete;
+
+    // tick the state was saved at
+    std::uint64_t tick() const { return saved_tick; }
+    // the array in place, empty if the snapshot doesn't have it
+    template<typename T, typename F>
+    std::span<const T> array(snapshot_section s, F field) const
+    {
+        std::size_t count;
+        auto* p = find(s, std::uint32_t(field), sizeof(T), count);
+        return { static_cast<const T*>(p), count };
+    }
+
+  private:
+    const void* find(snapshot_section s,
+                     std::uint32_t field,
+                     std::size_t element_size,
+                     std::size_t& count) const;
+    const unsigned char* base{ nullptr };
+    std::size_t length{ 0 };
+    std::uint32_t arrays{ 0 };
+    std::uint64_t saved_tick{ 0 };
+};
+
+// throw std::runtime_error if the file can't be written. quantized drops
+// the drones' exact positions, see above
+void
+save_snapshot(const std::string& path,
+              const drone_manager& dm,
+              std::uint64_t tick = 0,
+              bool quantized = false);
+void
+save_snapshot(const std::string& path, const game& g, bool quantized = false);
+
+/*
+replace the state with the snapshot's. the drones get new handles, and the
+indices rebuild on the next tick. throws std::runtime_error if the arrays
+of a section disagree on its size or the pools are too small
+*/
+void
+load_snapshot(const snapshot& snap, drone_manager& dm);
+void
+load_snapshot(const snapshot& snap, game& g);
@@ -0,0 +1,206 @@
+#pragma once
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <raylib.h>
+#include <span>
+#include <vector>
+
+#include "quadtree.h"
+#include "util.h"
+
+namespace yhl_util {
+
+// C is the precision of the cell size and the queries, float like Vector2
+template<has_pos T, std::floating_point C = float>
+class spatial_hash_grid
+{
+    /*
+    uniform grid over world space with square cells of cell_size. cells are
+    hashed into a bucket table twice the element count, so the grid is
+    unbounded and its memory tracks the number of elements, not the area.
+
+    build() counting sorts the elements by bucket into one flat array:
+    entries of bucket b are entries[starts[b] .. starts[b + 1]). several
+    cells can share a bucket, so every entry keeps the key of its cell and
+    queries skip entries of other cells. elements are indices into the
+    items of the last build
+    */
+    struct entry
+    {
+        std::uint32_t element;
+        std::uint64_t cell;
+    };
+    C cell_size;
+    C inv_cell_size;
+    std::uint64_t mask{ 0 };
+    std::vector<std::uint32_t> starts;
+    std::vector<entry> entries;
+    // bucket of every element during build
+    std::vector<std::uint32_t> buckets;
+
+    std::int32_t cell_of(C v) const
+    {
+        return std::int32_t(std::floor(v * inv_cell_size));
+    }
+    static std::uint64_t key(std::int32_t cx, std::int32_t cy)
+    {
+        return (std::uint64_t(std::uint32_t(cx)) << 32) | std::uint32_t(cy);
+    }
+    std::uint32_t bucket(std::int32_t cx, std::int32_t cy) const
+    {
+        return std::uint32_t(
+          (std::uint64_t(std::uint32_t(cx)) * 73856093u ^
+           std::uint64_t(std::uint32_t(cy)) * 19349663u) &
+          mask);
+    }
+
+  public:
+    spatial_hash_grid(C cell_size);
+    void build(std::span<const T> items);
+    void query(C,
+               C,
+               C,
+               C,
+               std::vector<std::uint32_t>&,
+               bool debug = false) const;
+    // calls visit(element) for every element in the cells overlapping the area
+    template<typename F>
+    void query(C, C, C, C, F&& visit) const;
+    /*
+    query into a per-thread scratch vector that is reused across calls. the
+    result is only valid until the next scratch query on the same thread
+    */
+    const std::vector<std::uint32_t>& query(C, C, C, C) const;
+    // cells a query over a w by h area walks
+    C cells_covered(C w, C h) const
+    {
+        return (std::floor(w * inv_cell_size) + 2) *
+               (std::floor(h * inv_cell_size) + 2);
+    }
+    // debug drawing of the occupied cells, in world space
+    void draw() const;
+    void clear();
+};
+
+template<has_pos T, std::floating_point C>
+spatial_hash_grid<T, C>::spatial_hash_grid(C cell_size)
+  : cell_size(cell_size)
+  , inv_cell_size(1 / cell_size)
+{
+}
+
+template<has_pos T, std::floating_point C>
+void
+spatial_hash_grid<T, C>::build(std::span<const T> items)
+{
+    auto n = items.size();
+    std::size_t bucket_count = std::bit_ceil(std::max<std::size_t>(64, 2 * n));
+    mask = bucket_count - 1;
+
+    // count, prefix sum, scatter
+    starts.assign(bucket_count + 1, 0);
+    buckets.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+        auto const& p = items[i].pos;
+        buckets[i] = bucket(cell_of(p.x), cell_of(p.y));
+        starts[buckets[i] + 1]++;
+    }
+    for (std::size_t b = 0; b < bucket_count; b++) {
+        starts[b + 1] += starts[b];
+    }
+    entries.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+        auto const& p = items[i].pos;
+        // starts[b] doubles as the fill cursor of bucket b
+        entries[starts[buckets[i]]++] =
+          entry{ std::uint32_t(i), key(cell_of(p.x), cell_of(p.y)) };
+    }
+    // the cursors now sit at the end of each bucket, shift them back
+    for (std::size_t b = bucket_count; b > 0; b--) {
+        starts[b] = starts[b - 1];
+    }
+    starts[0] = 0;
+}
+
+template<has_pos T, std::floating_point C>
+template<typename F>
+void
+spatial_hash_grid<T, C>::query(C x_, C y_, C w_, C h_, F&& visit) const
+{
+    if (entries.empty()) {
+        return;
+    }
+    auto cx0 = cell_of(x_);
+    auto cx1 = cell_of(x_ + w_);
+    auto cy0 = cell_of(y_);
+    auto cy1 = cell_of(y_ + h_);
+    for (auto cy = cy0; cy <= cy1; cy++) {
+        for (auto cx = cx0; cx <= cx1; cx++) {
+            auto k = key(cx, cy);
+            auto b = bucket(cx, cy);
+            for (auto i = starts[b]; i < starts[b + 1]; i++) {
+                if (entries[i].cell == k) {
+                    visit(entries[i].element);
+                }
+            }
+        }
+    }
+}
+
+template<has_pos T, std::floating_point C>
+void
+spatial_hash_grid<T, C>::query(C x_,
+                               C y_,
+                               C w_,
+                               C h_,
+                               std::vector<std::uint32_t>& res,
+                               bool debug) const
+{
+    query(x_, y_, w_, h_, [&](std::uint32_t e) { res.emplace_back(e); });
+    if (debug) {
+        for (auto cy = cell_of(y_); cy <= cell_of(y_ + h_); cy++) {
+            for (auto cx = cell_of(x_); cx <= cell_of(x_ + w_); cx++) {
+                DrawRectangleLinesEx(::Rectangle{ float(cx * cell_size),
+                                                  float(cy * cell_size),
+                                                  float(cell_size),
+                                                  float(cell_size) },
+                                     5,
+                                     RED);
+            }
+        }
+    }
+}
+
+template<has_pos T, std::floating_point C>
+const std::vector<std::uint32_t>&
+spatial_hash_grid<T, C>::query(C x_, C y_, C w_, C h_) const
+{
+    thread_local std::vector<std::uint32_t> scratch;
+    scratch.clear();
+    query(x_, y_, w_, h_, [&](std::uint32_t e) { scratch.emplace_back(e); });
+    return scratch;
+}
+
+template<has_pos T, std::floating_point C>
+void
+spatial_hash_grid<T, C>::draw() const
+{
+    for (auto const& e : entries) {
+        auto cx = std::int32_t(e.cell >> 32);
+        auto cy = std::int32_t(e.cell & 0xffffffff);
+        DrawRectangleLines(
+          cx * cell_size, cy * cell_size, cell_size, cell_size, WHITE);
+    }
+}
+
+template<has_pos T, std::floating_point C>
+void
+spatial_hash_grid<T, C>::clear()
+{
+    starts.clear();
+    entries.clear();
+}
+
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+fixed set of worker threads for data parallel loops. parallel_for hands out
+chunks of an index range to the workers and the calling thread, and returns
+once every chunk has run
+*/
+class thread_pool
+{
+  public:
+    // threads counts the calling thread, 0 uses every hardware thread
+    explicit thread_pool(unsigned threads = 0);
+    ~thread_pool();
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // threads working on a parallel_for, including the caller
+    unsigned size() const { return unsigned(workers.size()) + 1; }
+
+    // calls fn(begin, end) on chunks of at most grain indices covering [0, n)
+    template<typename F>
+    void parallel_for(std::size_t n, std::size_t grain, F&& fn)
+    {
+        run(
+          n,
+          std::max<std::size_t>(grain, 1),
+          [](void* ctx, std::size_t begin, std::size_t end) {
+              (*static_cast<std::remove_reference_t<F>*>(ctx))(begin, end);
+          },
+          &fn);
+    }
+    // as above, with chunks sized to give every thread a few of them
+    template<typename F>
+    void parallel_for(std::size_t n, F&& fn)
+    {
+        parallel_for(n, std::max<std::size_t>(64, n / (size() * 8)), fn);
+    }
+
+  private:
+    using chunk_fn = void (*)(void*, std::size_t, std::size_t);
+    void run(std::size_t n, std::size_t grain, chunk_fn fn, void* ctx);
+    void work();
+    void worker_loop();
+
+    std::vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::uint64_t generation{ 0 };
+    std::size_t pending{ 0 };
+    bool stopping{ false };
+
+    // the loop being run
+    chunk_fn job_fn{ nullptr };
+    void* job_ctx{ nullptr };
+    std::size_t job_n{ 0 };
+    std::size_t job_grain{ 1 };
+    std::atomic<std::size_t> next{ 0 };
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace yhl_util {
+
+template<typename T>
+class triple_buffer
+{
+    /*
+    hands values from one producer thread to one consumer thread without
+    either waiting on the other. of the three slots the writer owns one
+    (back), the reader one (front), and the third sits in the middle:
+    publish() swaps back with the middle, acquire() swaps front with it if
+    it holds something the reader hasn't seen. the reader always gets the
+    newest complete value and skips any it was too slow for
+    */
+    static constexpr std::uint8_t index_mask = 3;
+    // set in middle while it holds a value the reader hasn't taken
+    static constexpr std::uint8_t fresh = 4;
+
+    std::array<T, 3> slots;
+    std::atomic<std::uint8_t> middle{ 1 };
+    std::uint8_t back_slot{ 0 };
+    std::uint8_t front_slot{ 2 };
+
+  public:
+    // writer side: fill back(), then publish() it
+    T& back() { return slots[back_slot]; }
+    void publish()
+    {
+        back_slot = middle.exchange(back_slot | fresh,
+                                    std::memory_order_acq_rel) &
+                    index_mask;
+    }
+
+    // reader side: whether there is a newer value than front()
+    bool has_new() const
+    {
+        return middle.load(std::memory_order_acquire) & fresh;
+    }
+    // make the newest value front(), false if there is none
+    bool acquire()
+    {
+        if (!has_new()) {
+            return false;
+        }
+        front_slot =
+          middle.exchange(front_slot, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+    T& front() { return slots[front_slot]; }
+    const T& front() const { return slots[front_slot]; }
+};
+
+};
@@ -1,4 +1,7 @@
 #pragma once
+#include <cstddef>
+#include <new>
+#include <raylib.h>
 #include <stdexcept>
 #include <string>
 #include <variant>
@@ -113,14 +116,85 @@ class out
         return *this;
     }
 };
-struct Rectangle
+/*
+allocator handing out storage aligned to Align bytes, so vectorized loops can
+use aligned loads on the start of every array
+*/
+template<typename T, std::size_t Align = 64>
+struct aligned_allocator
 {
-    double x, y;          // Coordinates of the bottom-left corner
-    double width, height; // Width and height of the rectangle
+    using value_type = T;
+    template<typename U>
+    struct rebind
+    {
+        using other = aligned_allocator<U, Align>;
+    };
+
+    aligned_allocator() = default;
+    template<typename U>
+    aligned_allocator(const aligned_allocator<U, Align>&)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(
+          ::operator new(n * sizeof(T), std::align_val_t{ Align }));
+    }
+    void deallocate(T* p, std::size_t)
+    {
+        ::operator delete(p, std::align_val_t{ Align });
+    }
+
+    template<typename U>
+    bool operator==(const aligned_allocator<U, Align>&) const
+    {
+        return true;
+    }
 };
 
+template<typename T, std::size_t Align = 64>
+using aligned_vector = std::vector<T, aligned_allocator<T, Align>>;
+
+// rectangle in coordinates of type C, the spatial indices use their own
+template<typename C = double>
+struct basic_rectangle
+{
+    C x, y;          // Coordinates of the bottom-left corner
+    C width, height; // Width and height of the rectangle
+};
+using Rectangle = basic_rectangle<double>;
+
 // Function to check collision between two rectangles
+template<typename C>
+bool
+check_collision(const basic_rectangle<C>& rect1,
+                const basic_rectangle<C>& rect2)
+{
+    // Check if one rectangle is to the left of the other
+    if (rect1.x + rect1.width < rect2.x || rect2.x + rect2.width < rect1.x) {
+        return false; // No collision on the x-axis
+    }
+
+    // Check if one rectangle is above the other
+    if (rect1.y + rect1.height < rect2.y || rect2.y + rect2.height < rect1.y) {
+        return false; // No collision on the y-axis
+    }
+
+    // If neither condition is true, the rectangles overlap
+    return true;
+}
+
+/*
+swept point against circle: the earliest t in [0, 1] at which a point moving
+in a straight line from `from` to `to` is within radius of center, 0 if it
+starts inside. false if it never gets there
+*/
 bool
-check_collision(const Rectangle& rect1, const Rectangle& rect2);
+sweep_circle(::Vector2 from,
+             ::Vector2 to,
+             ::Vector2 center,
+             float radius,
+             out<float> t);
 
 };
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+#include <array>
+#include <compare>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <raylib.h>
+#include <set>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "drone.h"
+#include "drone_manager.h"
+
+// a chunk by its position in chunks, chunk (x, y) covers
+// [x, x + 1) * chunk_size by [y, y + 1) * chunk_size
+struct chunk_key
+{
+    std::int32_t x;
+    std::int32_t y;
+    auto operator<=>(const chunk_key&) const = default;
+};
+
+// the drones of one chunk, by species
+using chunk_drones = species_drones;
+
+struct world_settings
+{
+    // side of a chunk in world units
+    float chunk_size{ 2048 };
+    // chunks at most this many chunks from the player's are streamed in
+    int load_radius{ 1 };
+    // and those further than this streamed out, more than load_radius so
+    // a player on a chunk's edge doesn't stream it back and forth
+    int unload_radius{ 2 };
+    // where streamed out chunks are kept, empty keeps them in memory
+    std::string directory;
+};
+
+struct world_stats
+{
+    // chunks and drones out of the simulation, and what they take
+    std::size_t stored_chunks{ 0 };
+    std::size_t stored_drones{ 0 };
+    std::size_t stored_bytes{ 0 };
+    // chunks being read back
+    std::size_t loading{ 0 };
+    // since the world was made
+    std::size_t streamed_in{ 0 };
+    std::size_t streamed_out{ 0 };
+};
+
+/*
+a world bigger than what is simulated, cut into square chunks. the drones
+of the chunks near the player live in the drone_manager and its indices
+and run every tick; those of far away chunks are packed into a compact,
+losslessly compressed blob each, in memory or in a file per chunk, and cost
+nothing until the player comes back. the chunk a drone belongs to is where
+it is when its chunk is streamed out, so drones wander freely between the
+simulated chunks.
+
+packing, unpacking and file i/o run on a thread of the world's own; stream()
+hands it the chunks to move and merges the ones it has read back, on the
+thread that ticks the drone_manager, between ticks. when a chunk arrives
+depends on that thread, so a streaming run does not replay bit for bit.
+streamed drones get new handles.
+
+with a directory the world persists: chunks found there at start are part
+of it, and everything still simulated is written out when it is destroyed.
+errors from the streaming thread (a full disk, a damaged file) are thrown
+from the next stream()
+*/
+class world
+{
+  public:
+    world(drone_manager& dm, world_settings settings);
+    // streams everything simulated out and waits until it is stored
+    ~world();
+    world(const world&) = delete;
+    world& operator=(const world&) = delete;
+
+    chunk_key chunk_of(Vector2 pos) const;
+    // world space corner of a chunk
+    Vector2 origin(chunk_key key) const;
+
+    /*
+    add a chunk that is neither simulated nor stored yet straight to the
+    store, packed on the calling thread. for setting up big worlds
+    */
+    void seed(chunk_key key, const chunk_drones& drones);
+    /*
+    call between ticks: merge the chunks read back since the last call,
+    stream out the simulated drones in chunks beyond unload_radius and start
+    reading back the stored chunks within load_radius of the player.
+    scanning the swarm costs about as much as a pack, so every few ticks is
+    plenty
+    */
+    void stream(Vector2 player_pos);
+    // wait for the streaming thread to finish what it was handed
+    void flush();
+
+    world_stats stats() const;
+
+  private:
+    struct job
+    {
+        bool load;
+        chunk_key key;
+        // drones to add to the chunk, unless it is a load
+        chunk_drones drones;
+    };
+    struct stored_chunk
+    {
+        // empty when it is in a file
+        std::vector<std::uint8_t> blob;
+        std::size_t drones{ 0 };
+        std::size_t bytes{ 0 };
+    };
+
+    // the streaming thread
+    void run();
+    // stream out the simulated drones in the chunks far(key) is true of
+    template<typename F>
+    void evict(F&& far);
+    void stash(chunk_key key, chunk_drones&& drones);
+    void merge(const chunk_drones& drones);
+    // store a packed chunk of n drones, replacing what was stored of it
+    void put(chunk_key key, std::vector<std::uint8_t>&& blob, std::size_t n);
+    // remove a chunk from the store, empty if it wasn't there
+    chunk_drones take(chunk_key key);
+    std::string path_of(chunk_key key) const;
+
+    drone_manager& dm;
+    world_settings settings;
+
+    // chunks stored or on their way there, and those being read back
+    std::set<chunk_key> out;
+    std::set<chunk_key> loading;
+    std::size_t streamed_in{ 0 };
+    std::size_t streamed_out{ 0 };
+
+    mutable std::mutex store_lock;
+    std::map<chunk_key, stored_chunk> store;
+    std::size_t stored_drones{ 0 };
+    std::size_t stored_bytes{ 0 };
+
+    // the streaming thread's queue, its results and its error
+    std::mutex jobs_lock;
+    std::condition_variable jobs_changed;
+    std::deque<job> jobs;
+    bool busy{ false };
+    bool stopping{ false };
+    std::vector<std::pair<chunk_key, chunk_drones>> ready;
+    std::exception_ptr error;
+    std::thread worker;
+};
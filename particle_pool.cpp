@@ -0,0 +1,49 @@
+#include "particle_pool.h"
+
+particle_pool::particle_pool(std::size_t capacity)
+  : pos(capacity)
+  , vel(capacity)
+  , age(capacity)
+  , lifetime(capacity)
+{
+}
+
+bool
+particle_pool::spawn(Vector2 p, Vector2 v, std::uint32_t ticks)
+{
+    if (count == capacity()) {
+        return false;
+    }
+    pos[count] = p;
+    vel[count] = v;
+    age[count] = 0;
+    lifetime[count] = ticks > 0 ? ticks : 1;
+    count++;
+    return true;
+}
+
+void
+particle_pool::advance()
+{
+    for (std::size_t i = 0; i < count; i++) {
+        pos[i].x += vel[i].x;
+        pos[i].y += vel[i].y;
+        age[i]++;
+    }
+}
+
+void
+particle_pool::expire()
+{
+    for (std::size_t i = 0; i < count;) {
+        if (age[i] < lifetime[i]) {
+            i++;
+            continue;
+        }
+        count--;
+        pos[i] = pos[count];
+        vel[i] = vel[count];
+        age[i] = age[count];
+        lifetime[i] = lifetime[count];
+    }
+}
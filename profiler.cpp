@@ -0,0 +1,192 @@
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace yhl_util::profiler {
+
+namespace {
+struct event
+{
+    const char* name;
+    // nanoseconds since origin
+    std::int64_t start;
+    std::int64_t end;
+};
+
+// zones of one thread, the newest overwrite the oldest once it is full
+struct ring
+{
+    static constexpr std::size_t capacity = 1 << 16;
+
+    std::vector<event> events = std::vector<event>(capacity);
+    std::uint64_t written{ 0 };
+    std::uint32_t thread;
+
+    template<typename F>
+    void for_each(F&& fn) const
+    {
+        auto n = std::min<std::uint64_t>(written, capacity);
+        for (auto i = written - n; i < written; i++) {
+            fn(events[i % capacity]);
+        }
+    }
+};
+
+std::atomic<bool> on{ false };
+const clock::time_point origin = clock::now();
+
+// the rings outlive their threads, so a finished worker's zones still count
+std::mutex rings_lock;
+std::vector<std::unique_ptr<ring>> rings;
+
+ring&
+this_thread_ring()
+{
+    thread_local ring* mine = [] {
+        std::lock_guard lock{ rings_lock };
+        rings.emplace_back(std::make_unique<ring>());
+        rings.back()->thread = std::uint32_t(rings.size());
+        return rings.back().get();
+    }();
+    return *mine;
+}
+
+std::int64_t
+since_origin(clock::time_point t)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin)
+      .count();
+}
+
+double
+percentile(const std::vector<double>& sorted, double p)
+{
+    // nearest rank
+    auto rank = std::size_t(std::ceil(p * sorted.size()));
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+};
+
+void
+enable(bool state)
+{
+    on.store(state, std::memory_order_relaxed);
+}
+
+bool
+enabled()
+{
+    return on.load(std::memory_order_relaxed);
+}
+
+void
+reset()
+{
+    std::lock_guard lock{ rings_lock };
+    for (auto& r : rings) {
+        r->written = 0;
+    }
+}
+
+zone::~zone()
+{
+    if (!name) {
+        return;
+    }
+    auto end = clock::now();
+    auto& r = this_thread_ring();
+    r.events[r.written % ring::capacity] =
+      event{ name, since_origin(start), since_origin(end) };
+    r.written++;
+}
+
+std::vector<phase_stats>
+summary()
+{
+    std::unordered_map<std::string, std::vector<double>> durations;
+    {
+        std::lock_guard lock{ rings_lock };
+        for (auto const& r : rings) {
+            r->for_each([&](const event& e) {
+                durations[e.name].emplace_back((e.end - e.start) / 1e3);
+            });
+        }
+    }
+    std::vector<phase_stats> stats;
+    for (auto& [name, d] : durations) {
+        std::sort(d.begin(), d.end());
+        phase_stats s{ name, d.size() };
+        s.p50 = percentile(d, 0.5);
+        s.p99 = percentile(d, 0.99);
+        s.max = d.back();
+        for (auto v : d) {
+            s.total += v;
+        }
+        stats.emplace_back(std::move(s));
+    }
+    std::sort(stats.begin(), stats.end(), [](auto const& a, auto const& b) {
+        return a.total > b.total;
+    });
+    return stats;
+}
+
+void
+write_summary(std::ostream& out)
+{
+    auto stats = summary();
+    std::size_t width = 4;
+    for (auto const& s : stats) {
+        width = std::max(width, s.name.size());
+    }
+    auto flags = out.flags();
+    out << std::left << std::setw(int(width)) << "zone" << std::right
+        << std::setw(10) << "count" << std::setw(12) << "p50 us"
+        << std::setw(12) << "p99 us" << std::setw(12) << "max us"
+        << std::setw(12) << "total ms" << "\n";
+    out << std::fixed << std::setprecision(1);
+    for (auto const& s : stats) {
+        out << std::left << std::setw(int(width)) << s.name << std::right
+            << std::setw(10) << s.count << std::setw(12) << s.p50
+            << std::setw(12) << s.p99 << std::setw(12) << s.max
+            << std::setw(12) << s.total / 1e3 << "\n";
+    }
+    out.flags(flags);
+}
+
+bool
+write_chrome_trace(const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << "{\"traceEvents\":[\n" << std::fixed << std::setprecision(3);
+    bool first = true;
+    std::lock_guard lock{ rings_lock };
+    for (auto const& r : rings) {
+        r->for_each([&](const event& e) {
+            out << (first ? "" : ",\n") << "{\"name\":\"";
+            for (auto* c = e.name; *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    out << '\\';
+                }
+                out << *c;
+            }
+            // complete events, timestamps in microseconds
+            out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r->thread
+                << ",\"ts\":" << e.start / 1e3
+                << ",\"dur\":" << (e.end - e.start) / 1e3 << "}";
+            first = false;
+        });
+    }
+    out << "\n]}\n";
+    return bool(out.flush());
+}
+
+};
@@ -0,0 +1,141 @@
+#include "replay.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+constexpr char magic[4] = { 'G', '7', 'R', 'P' };
+
+template<typename T>
+void
+put(std::ostream& out, T v)
+{
+    static_assert(sizeof(T) == 1 || sizeof(T) == 4 || sizeof(T) == 8);
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &v, sizeof(T));
+    if constexpr (std::endian::native == std::endian::big) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    out.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+template<typename T>
+bool
+get(std::istream& in, T& v)
+{
+    unsigned char bytes[sizeof(T)];
+    if (!in.read(reinterpret_cast<char*>(bytes), sizeof(T))) {
+        return false;
+    }
+    if constexpr (std::endian::native == std::endian::big) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    std::memcpy(&v, bytes, sizeof(T));
+    return true;
+}
+};
+
+replay_writer::replay_writer(const std::string& path,
+                             const replay_header& header)
+  : out(path, std::ios::binary | std::ios::trunc)
+{
+    if (!out) {
+        throw std::runtime_error("can't write replay " + path);
+    }
+    out.write(magic, sizeof(magic));
+    put(out, header.version);
+    put(out, header.seed);
+    put(out, header.drones);
+    put(out, header.tick_rate);
+    put(out, std::uint8_t(header.simd));
+    put(out, std::uint8_t(header.index));
+}
+
+replay_writer::~replay_writer()
+{
+    flush_run();
+}
+
+void
+replay_writer::record(const tick_input& in)
+{
+    if (run > 0 && !(in == held)) {
+        flush_run();
+    }
+    held = in;
+    run++;
+}
+
+void
+replay_writer::flush_run()
+{
+    if (run == 0) {
+        return;
+    }
+    put(out, run);
+    put(out, held.mouse.x);
+    put(out, held.mouse.y);
+    put(out, held.wheel);
+    put(out, held.buttons);
+    put(out, held.keys);
+    run = 0;
+    // the stream buffers the runs between, a crash loses at most those
+    if (++unflushed == flush_every) {
+        unflushed = 0;
+        out.flush();
+    }
+}
+
+replay_reader::replay_reader(const std::string& path)
+  : file(path, std::ios::binary)
+{
+    char m[sizeof(magic)];
+    if (!file || !file.read(m, sizeof(m)) ||
+        std::memcmp(m, magic, sizeof(magic)) != 0) {
+        throw std::runtime_error(path + " is not a replay log");
+    }
+    if (!get(file, head.version) ||
+        head.version != replay_header::current_version) {
+        throw std::runtime_error(path + ": unsupported replay version");
+    }
+    if (!get(file, head.seed) || !get(file, head.drones) ||
+        !get(file, head.tick_rate)) {
+        throw std::runtime_error(path + ": truncated replay header");
+    }
+    std::uint8_t simd;
+    std::uint8_t index;
+    if (!get(file, simd) || !get(file, index)) {
+        throw std::runtime_error(path + ": truncated replay header");
+    }
+    if (simd > std::uint8_t(simd_level::avx2) ||
+        index > std::uint8_t(broadphase::grid)) {
+        throw std::runtime_error(path + ": bad replay header");
+    }
+    head.simd = simd_level(simd);
+    head.index = broadphase(index);
+}
+
+bool
+replay_reader::next(tick_input& in)
+{
+    if (run == 0) {
+        if (!get(file, run) || !get(file, held.mouse.x) ||
+            !get(file, held.mouse.y) || !get(file, held.wheel) ||
+            !get(file, held.buttons) || !get(file, held.keys) || run == 0) {
+            // a torn last record is dropped, like a clean end
+            run = 0;
+            return false;
+        }
+    }
+    run--;
+    in = held;
+    return true;
+}
+
+bool
+use_recorded_setup(const replay_header& header, game& g)
+{
+    g.dm.use_broadphase(header.index);
+    return set_simd_level(header.simd) == header.simd;
+}
@@ -0,0 +1,571 @@
+#include "shard.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+/*
+a message is a u64 byte count and that many bytes. between neighbors they
+hold per species the drones handed over, then per species the ghosts; from
+a worker to the parent its shard_stats, then per species its drones. drones
+go as they are in memory, both ends being the same binary on one host
+*/
+using message = std::vector<std::uint8_t>;
+
+constexpr float infinity = std::numeric_limits<float>::infinity();
+
+template<typename T>
+void
+put(message& out, const T& v)
+{
+    auto at = out.size();
+    out.resize(at + sizeof(T));
+    std::memcpy(out.data() + at, &v, sizeof(T));
+}
+
+template<typename T>
+T
+get(const message& in, std::size_t& at)
+{
+    if (in.size() - at < sizeof(T)) {
+        throw std::runtime_error("shard message truncated");
+    }
+    T v;
+    std::memcpy(&v, in.data() + at, sizeof(T));
+    at += sizeof(T);
+    return v;
+}
+
+void
+put_drones(message& out, const std::vector<drone>& drones)
+{
+    put(out, std::uint64_t(drones.size()));
+    auto at = out.size();
+    out.resize(at + drones.size() * sizeof(drone));
+    if (!drones.empty()) {
+        std::memcpy(
+          out.data() + at, drones.data(), drones.size() * sizeof(drone));
+    }
+}
+
+void
+get_drones(const message& in, std::size_t& at, std::vector<drone>& drones)
+{
+    auto n = get<std::uint64_t>(in, at);
+    if ((in.size() - at) / sizeof(drone) < n) {
+        throw std::runtime_error("shard message truncated");
+    }
+    auto first = drones.size();
+    drones.resize(first + n);
+    if (n > 0) {
+        std::memcpy(drones.data() + first, in.data() + at, n * sizeof(drone));
+    }
+    at += n * sizeof(drone);
+}
+
+// an empty message, its length filled in by seal
+message
+open_message()
+{
+    message m;
+    put(m, std::uint64_t(0));
+    return m;
+}
+
+void
+seal(message& m)
+{
+    std::uint64_t n = m.size() - sizeof(std::uint64_t);
+    std::memcpy(m.data(), &n, sizeof(n));
+}
+
+[[noreturn]] void
+fail(const std::string& what)
+{
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+void
+write_all(int fd, const message& m)
+{
+    std::size_t sent = 0;
+    while (sent < m.size()) {
+        auto n = ::send(fd, m.data() + sent, m.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno != EINTR) {
+            fail("shard send");
+        }
+        sent += n > 0 ? std::size_t(n) : 0;
+    }
+}
+
+// one whole message, without the length
+message
+read_message(int fd)
+{
+    message m(sizeof(std::uint64_t));
+    std::size_t got = 0;
+    while (got < m.size()) {
+        auto n = ::recv(fd, m.data() + got, m.size() - got, 0);
+        if (n == 0) {
+            throw std::runtime_error("shard hung up");
+        }
+        if (n < 0 && errno != EINTR) {
+            fail("shard recv");
+        }
+        got += n > 0 ? std::size_t(n) : 0;
+        if (got == sizeof(std::uint64_t) && m.size() == got) {
+            std::uint64_t len;
+            std::memcpy(&len, m.data(), sizeof(len));
+            m.resize(got + len);
+        }
+    }
+    m.erase(m.begin(), m.begin() + sizeof(std::uint64_t));
+    return m;
+}
+
+/*
+send out[k] on fds[k] and read a message from each, all at once over
+non-blocking sockets, so two neighbors sending each other more than a
+socket holds don't both wait for the other to read
+*/
+void
+exchange(const std::vector<int>& fds,
+         const std::vector<message>& out,
+         std::vector<message>& in)
+{
+    auto n = fds.size();
+    std::vector<std::size_t> sent(n, 0), got(n, 0);
+    in.assign(n, message(sizeof(std::uint64_t)));
+    auto done = [&](std::size_t k) {
+        return sent[k] == out[k].size() && got[k] == in[k].size();
+    };
+    std::vector<pollfd> polls(n);
+    for (;;) {
+        bool pending = false;
+        for (std::size_t k = 0; k < n; k++) {
+            polls[k] = { fds[k], 0, 0 };
+            if (sent[k] < out[k].size()) {
+                polls[k].events |= POLLOUT;
+            }
+            if (got[k] < in[k].size()) {
+                polls[k].events |= POLLIN;
+            }
+            pending |= !done(k);
+        }
+        if (!pending) {
+            break;
+        }
+        if (::poll(polls.data(), n, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("shard poll");
+        }
+        for (std::size_t k = 0; k < n; k++) {
+            auto ev = polls[k].revents;
+            if ((ev & POLLOUT) && sent[k] < out[k].size()) {
+                auto r = ::send(fds[k],
+                                out[k].data() + sent[k],
+                                out[k].size() - sent[k],
+                                MSG_NOSIGNAL);
+                if (r < 0 && errno != EAGAIN && errno != EINTR) {
+                    fail("shard send");
+                }
+                sent[k] += r > 0 ? std::size_t(r) : 0;
+            }
+            bool readable = ev & (POLLIN | POLLHUP | POLLERR);
+            if (readable && got[k] < in[k].size()) {
+                auto r = ::recv(fds[k],
+                                in[k].data() + got[k],
+                                in[k].size() - got[k],
+                                0);
+                if (r == 0) {
+                    throw std::runtime_error("shard neighbor hung up");
+                }
+                if (r < 0 && errno != EAGAIN && errno != EINTR) {
+                    fail("shard recv");
+                }
+                got[k] += r > 0 ? std::size_t(r) : 0;
+                // the length is in, make room for the rest
+                if (got[k] == sizeof(std::uint64_t) &&
+                    in[k].size() == got[k]) {
+                    std::uint64_t len;
+                    std::memcpy(&len, in[k].data(), sizeof(len));
+                    in[k].resize(got[k] + len);
+                }
+            }
+        }
+    }
+    for (auto& m : in) {
+        m.erase(m.begin(), m.begin() + sizeof(std::uint64_t));
+    }
+}
+
+constexpr species all_species[] = { species::green,
+                                    species::red,
+                                    species::yellow };
+
+/*
+what a worker process does, start to finish: the message for the parent.
+left or right is -1 at the edges
+*/
+message
+run_worker(std::size_t i,
+           const drone_manager& whole,
+           const shard_layout& layout,
+           std::uint64_t ticks,
+           Vector2 player_pos,
+           unsigned threads,
+           const std::function<void(drone_manager&)>& setup,
+           int left,
+           int right)
+{
+    std::mt19937 unused;
+    drone_manager dm{ 0, unused, threads };
+    dm.interactions = whole.interactions;
+    setup(dm);
+    for (auto s : all_species) {
+        auto& ds = dm.drones(s);
+        ds.clear();
+        for (auto const& d : whole.drones(s).values()) {
+            if (layout.owner(d.pos.x) == i) {
+                ds.insert(d);
+            }
+        }
+        dm.index_for(s).invalidate();
+    }
+
+    float lo = layout.lo(i);
+    float hi = layout.hi(i);
+    float reach = whole.reach();
+    std::vector<int> fds;
+    // per neighbor, where its strip is: -1 left, 1 right
+    std::vector<int> sides;
+    if (left >= 0) {
+        fds.emplace_back(left);
+        sides.emplace_back(-1);
+    }
+    if (right >= 0) {
+        fds.emplace_back(right);
+        sides.emplace_back(1);
+    }
+
+    shard_stats st;
+    st.shard = std::uint32_t(i);
+    species_drones ghosts;
+    std::vector<message> out(fds.size()), in;
+    std::vector<species_drones> leaving(fds.size());
+    using clock = std::chrono::steady_clock;
+
+    auto share = [&](bool with_ghosts) {
+        GAME7_ZONE("shard exchange");
+        auto start = clock::now();
+        // drones that left the strip, back to front as in removing the dead
+        for (auto& l : leaving) {
+            for (auto& ds : l) {
+                ds.clear();
+            }
+        }
+        for (auto s : all_species) {
+            auto& ds = dm.drones(s);
+            auto& index = dm.index_for(s);
+            for (auto j = ds.size(); j-- > 0;) {
+                float x = ds[j].pos.x;
+                int side = x < lo ? -1 : x >= hi ? 1 : 0;
+                if (side == 0) {
+                    continue;
+                }
+                auto k = std::size_t(std::find(sides.begin(), sides.end(),
+                                               side) -
+                                     sides.begin());
+                leaving[k][std::size_t(s)].emplace_back(ds[j]);
+                index.swap_remove(j, ds.size() - 1);
+                ds.erase_at(j);
+                st.migrated++;
+            }
+        }
+        for (std::size_t k = 0; k < fds.size(); k++) {
+            auto& m = out[k];
+            m = open_message();
+            for (auto s : all_species) {
+                put_drones(m, leaving[k][std::size_t(s)]);
+            }
+            for (auto s : all_species) {
+                auto& g = ghosts[std::size_t(s)];
+                g.clear();
+                if (with_ghosts) {
+                    for (auto const& d : dm.drones(s).values()) {
+                        if (sides[k] < 0 ? d.pos.x < lo + reach
+                                         : d.pos.x >= hi - reach) {
+                            g.emplace_back(d);
+                        }
+                    }
+                }
+                st.ghosts_sent += g.size();
+                put_drones(m, g);
+            }
+            seal(m);
+        }
+
+        exchange(fds, out, in);
+
+        for (auto& g : ghosts) {
+            g.clear();
+        }
+        for (auto const& m : in) {
+            std::size_t at = 0;
+            for (auto s : all_species) {
+                species_drones arrived;
+                get_drones(m, at, arrived[std::size_t(s)]);
+                for (auto const& d : arrived[std::size_t(s)]) {
+                    dm.drones(s).insert(d);
+                }
+                dm.index_for(s).invalidate();
+            }
+            for (auto s : all_species) {
+                get_drones(m, at, ghosts[std::size_t(s)]);
+            }
+        }
+        // the neighbors' ghosts leave out what they were just handed, so
+        // the drones that left are still felt from this side
+        for (std::size_t k = 0; with_ghosts && k < fds.size(); k++) {
+            for (auto s : all_species) {
+                for (auto const& d : leaving[k][std::size_t(s)]) {
+                    if (d.pos.x >= lo - reach && d.pos.x < hi + reach) {
+                        ghosts[std::size_t(s)].emplace_back(d);
+                    }
+                }
+            }
+        }
+        st.exchange_seconds +=
+          std::chrono::duration<double>(clock::now() - start).count();
+    };
+
+    share(true);
+    for (std::uint64_t t = 1; t <= ticks; t++) {
+        auto start = clock::now();
+        dm.tick(player_pos, ghosts);
+        st.tick_seconds +=
+          std::chrono::duration<double>(clock::now() - start).count();
+        // the drones that crossed last go over even after the last tick
+        share(t < ticks);
+    }
+
+    for (auto s : all_species) {
+        st.drones += dm.drones(s).size();
+    }
+    auto m = open_message();
+    put(m, st);
+    for (auto s : all_species) {
+        put_drones(m, dm.drones(s).values());
+    }
+    seal(m);
+    return m;
+}
+
+void
+worker_main(std::size_t i,
+            const drone_manager& whole,
+            const shard_layout& layout,
+            std::uint64_t ticks,
+            Vector2 player_pos,
+            unsigned threads,
+            const std::function<void(drone_manager&)>& setup,
+            int left,
+            int right,
+            int parent)
+{
+    int status = 0;
+    try {
+        write_all(parent,
+                  run_worker(i,
+                             whole,
+                             layout,
+                             ticks,
+                             player_pos,
+                             threads,
+                             setup,
+                             left,
+                             right));
+    } catch (const std::exception& e) {
+        std::cerr << "shard " << i << ": " << e.what() << std::endl;
+        status = 1;
+    }
+    // no destructors or atexit handlers of the parent's objects
+    std::_Exit(status);
+}
+};
+
+std::size_t
+shard_layout::owner(float x) const
+{
+    return std::size_t(std::upper_bound(cuts.begin(), cuts.end(), x) -
+                       cuts.begin());
+}
+
+float
+shard_layout::lo(std::size_t i) const
+{
+    return i == 0 ? -infinity : cuts[i - 1];
+}
+
+float
+shard_layout::hi(std::size_t i) const
+{
+    return i == cuts.size() ? infinity : cuts[i];
+}
+
+shard_layout
+split_swarm(const drone_manager& dm, std::size_t n, float min_width)
+{
+    std::vector<float> xs;
+    for (auto s : all_species) {
+        for (auto const& d : dm.drones(s).values()) {
+            xs.emplace_back(d.pos.x);
+        }
+    }
+    std::sort(xs.begin(), xs.end());
+    shard_layout layout;
+    for (std::size_t k = 1; k < n; k++) {
+        float cut = xs.empty() ? 0.f : xs[xs.size() * k / n];
+        if (!layout.cuts.empty()) {
+            cut = std::max(cut, layout.cuts.back() + min_width);
+        }
+        layout.cuts.emplace_back(cut);
+    }
+    return layout;
+}
+
+std::vector<shard_stats>
+run_sharded(drone_manager& dm,
+            const shard_layout& layout,
+            std::uint64_t ticks,
+            Vector2 player_pos,
+            unsigned threads,
+            const std::function<void(drone_manager&)>& setup)
+{
+    auto n = layout.count();
+    // chain[k] links shard k (end 0) with shard k + 1 (end 1), control[i]
+    // this process (end 0) with shard i (end 1)
+    std::vector<std::array<int, 2>> chain(n - 1, { -1, -1 });
+    std::vector<std::array<int, 2>> control(n, { -1, -1 });
+    auto close_all = [&](auto&& keep) {
+        for (auto* pairs : { &chain, &control }) {
+            for (auto& p : *pairs) {
+                for (auto& fd : p) {
+                    if (fd >= 0 && !keep(fd)) {
+                        ::close(fd);
+                        fd = -1;
+                    }
+                }
+            }
+        }
+    };
+    auto none = [](int) { return false; };
+    for (auto* pairs : { &chain, &control }) {
+        for (auto& p : *pairs) {
+            if (::socketpair(AF_UNIX, SOCK_STREAM, 0, p.data()) < 0) {
+                close_all(none);
+                fail("shard socketpair");
+            }
+        }
+    }
+    for (auto& p : chain) {
+        for (auto fd : p) {
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+
+    // or the children print it again
+    std::cout.flush();
+    std::cerr.flush();
+    std::vector<pid_t> pids;
+    for (std::size_t i = 0; i < n; i++) {
+        auto pid = ::fork();
+        if (pid < 0) {
+            int e = errno;
+            close_all(none);
+            for (auto p : pids) {
+                ::waitpid(p, nullptr, 0);
+            }
+            errno = e;
+            fail("shard fork");
+        }
+        if (pid == 0) {
+            int left = i > 0 ? chain[i - 1][1] : -1;
+            int right = i + 1 < n ? chain[i][0] : -1;
+            int parent = control[i][1];
+            close_all([&](int fd) {
+                return fd == left || fd == right || fd == parent;
+            });
+            worker_main(i,
+                        dm,
+                        layout,
+                        ticks,
+                        player_pos,
+                        threads,
+                        setup,
+                        left,
+                        right,
+                        parent);
+        }
+        pids.emplace_back(pid);
+    }
+    // only the workers talk on these, and a worker dying must hang up on
+    // its neighbors
+    close_all([&](int fd) {
+        return std::any_of(control.begin(), control.end(), [&](auto& p) {
+            return p[0] == fd;
+        });
+    });
+
+    std::vector<message> results(n);
+    std::string failed;
+    for (std::size_t i = 0; i < n; i++) {
+        try {
+            results[i] = read_message(control[i][0]);
+        } catch (const std::exception& e) {
+            failed = "shard " + std::to_string(i) + " failed";
+        }
+    }
+    close_all(none);
+    for (std::size_t i = 0; i < n; i++) {
+        int status = 0;
+        if (::waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+            failed = "shard " + std::to_string(i) + " failed";
+        }
+    }
+    if (!failed.empty()) {
+        throw std::runtime_error(failed);
+    }
+
+    std::vector<shard_stats> stats;
+    for (auto s : all_species) {
+        dm.drones(s).clear();
+        dm.index_for(s).invalidate();
+    }
+    for (auto const& m : results) {
+        std::size_t at = 0;
+        stats.emplace_back(get<shard_stats>(m, at));
+        for (auto s : all_species) {
+            std::vector<drone> ds;
+            get_drones(m, at, ds);
+            for (auto const& d : ds) {
+                dm.drones(s).insert(d);
+            }
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,48 @@
+#include "sim_clock.h"
+#include <algorithm>
+#include <cmath>
+
+sim_clock::sim_clock(double tick_rate, std::uint32_t max_ticks)
+  : rate(tick_rate)
+  , step(1 / tick_rate)
+  , max_ticks(max_ticks)
+  , last(clock::now())
+{
+}
+
+std::uint32_t
+sim_clock::begin_frame()
+{
+    auto now = clock::now();
+    frame = std::chrono::duration<double>(now - last).count();
+    last = now;
+    accumulator += frame;
+    auto due = std::uint32_t(accumulator / step);
+    if (due > max_ticks) {
+        // fall behind by whole ticks, keep the phase
+        accumulator -= (due - max_ticks) * step;
+        due = max_ticks;
+    }
+    return due;
+}
+
+void
+sim_clock::advance()
+{
+    accumulator = std::max(0.0, accumulator - step);
+    ticks++;
+}
+
+std::uint32_t
+sim_clock::ticks_for(std::chrono::duration<double> d) const
+{
+    return ticks_for(d, rate);
+}
+
+std::uint32_t
+sim_clock::ticks_for(std::chrono::duration<double> d, double tick_rate)
+{
+    // a hair under, so 0.4 s at 60 Hz is 24 ticks and not 25
+    auto n = std::uint32_t(std::ceil(d.count() * tick_rate - 1e-9));
+    return std::max<std::uint32_t>(1, n);
+}
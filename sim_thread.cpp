@@ -0,0 +1,126 @@
+#include "sim_thread.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+
+sim_thread::sim_thread(game& g,
+                       double tick_rate,
+                       bool paced,
+                       replay_reader* replay,
+                       replay_writer* record)
+  : g(g)
+  , tick_rate(tick_rate)
+  , paced(paced)
+  , replay(replay)
+  , record(record)
+{
+}
+
+sim_thread::~sim_thread()
+{
+    stop();
+}
+
+void
+sim_thread::start()
+{
+    stopping.store(false);
+    worker = std::thread([this] { run(); });
+}
+
+void
+sim_thread::stop()
+{
+    stopping.store(true);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void
+sim_thread::feed(const tick_input& frame)
+{
+    std::lock_guard lock{ input_lock };
+    pending.mouse = frame.mouse;
+    pending.wheel += frame.wheel;
+    pending.buttons = (pending.buttons & ~tick_input::left_down) |
+                      frame.buttons;
+    pending.keys |= frame.keys;
+}
+
+tick_input
+sim_thread::take_input()
+{
+    std::lock_guard lock{ input_lock };
+    auto in = pending;
+    // presses and wheel are used up, what is held stays
+    pending.wheel = 0;
+    pending.buttons &= tick_input::left_down;
+    pending.keys = 0;
+    return in;
+}
+
+bool
+sim_thread::acquire()
+{
+    if (!frames.has_new()) {
+        return false;
+    }
+    // the old front is the frame before, its slot gets the stale contents
+    std::swap(prev, frames.front());
+    return frames.acquire();
+}
+
+float
+sim_thread::alpha(sim_clock::clock::time_point now) const
+{
+    auto const& cur = latest();
+    if (prev.time >= cur.time) {
+        return 1;
+    }
+    // render runs a snapshot interval behind the simulation
+    std::chrono::duration<double> interval = cur.time - prev.time;
+    std::chrono::duration<double> since = now - cur.time;
+    return float(std::clamp(since / interval, 0.0, 1.0));
+}
+
+void
+sim_thread::run()
+{
+    sim_clock clock{ tick_rate };
+    tick_input in;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        std::uint32_t steps = paced ? clock.begin_frame() : 1;
+        for (std::uint32_t step = 0; step < steps; step++) {
+            if (replay) {
+                if (!replay->next(in)) {
+                    done.store(true, std::memory_order_release);
+                    break;
+                }
+            } else {
+                in = take_input();
+            }
+            if (record) {
+                record->record(in);
+            }
+            std::lock_guard lock{ game_lock };
+            g.step(in);
+            clock.advance();
+        }
+        if (steps > 0) {
+            std::lock_guard lock{ game_lock };
+            auto& snap = frames.back();
+            capture(snap, g, in.mouse);
+            snap.time = sim_clock::clock::now();
+            frames.publish();
+        }
+        if (finished()) {
+            return;
+        }
+        if (paced) {
+            GAME7_ZONE("sim idle");
+            std::this_thread::sleep_for(
+              std::chrono::duration<double>(clock.until_next()));
+        }
+    }
+}
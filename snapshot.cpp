@@ -0,0 +1,457 @@
+#include "snapshot.h"
+#include "quantized.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr char magic[4] = { 'G', '7', 'S', 'N' };
+constexpr std::size_t alignment = 64;
+
+struct file_header
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t arrays;
+    std::uint32_t reserved;
+    std::uint64_t tick;
+};
+static_assert(sizeof(file_header) == 24);
+
+struct table_entry
+{
+    std::uint32_t section;
+    std::uint32_t field;
+    std::uint32_t element_size;
+    std::uint32_t reserved;
+    std::uint64_t count;
+    std::uint64_t offset;
+};
+static_assert(sizeof(table_entry) == 32);
+
+constexpr std::uint64_t
+align_up(std::uint64_t n)
+{
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+void
+require_little_endian()
+{
+    if constexpr (std::endian::native != std::endian::little) {
+        throw std::runtime_error("snapshots need a little-endian host");
+    }
+}
+
+// the arrays of one snapshot, written out in one go
+class snapshot_writer
+{
+  public:
+    template<typename T, typename F>
+    void add(snapshot_section s, F field, std::span<const T> data)
+    {
+        arrays.emplace_back(
+          table_entry{
+            std::uint32_t(s), std::uint32_t(field), sizeof(T), 0, data.size() },
+          data.data());
+    }
+    void write(const std::string& path, std::uint64_t tick);
+
+  private:
+    struct pending
+    {
+        table_entry entry;
+        const void* data;
+    };
+    std::vector<pending> arrays;
+};
+
+void
+snapshot_writer::write(const std::string& path, std::uint64_t tick)
+{
+    require_little_endian();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("can't write snapshot " + path);
+    }
+    file_header header{ {}, snapshot::current_version, 0, 0, tick };
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.arrays = std::uint32_t(arrays.size());
+
+    std::uint64_t offset =
+      align_up(sizeof(header) + arrays.size() * sizeof(table_entry));
+    for (auto& a : arrays) {
+        a.entry.offset = offset;
+        offset = align_up(offset + a.entry.count * a.entry.element_size);
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::uint64_t at = sizeof(header);
+    for (auto const& a : arrays) {
+        out.write(reinterpret_cast<const char*>(&a.entry), sizeof(a.entry));
+        at += sizeof(a.entry);
+    }
+    static constexpr char zeros[alignment]{};
+    for (auto const& a : arrays) {
+        out.write(zeros, std::streamsize(a.entry.offset - at));
+        auto bytes = a.entry.count * a.entry.element_size;
+        out.write(static_cast<const char*>(a.data), std::streamsize(bytes));
+        at = a.entry.offset + bytes;
+    }
+    if (!out.flush()) {
+        throw std::runtime_error("can't write snapshot " + path);
+    }
+}
+
+constexpr std::array<species, species_count> all_species{ species::green,
+                                                           species::red,
+                                                           species::yellow };
+
+snapshot_section
+section_of(species s)
+{
+    return snapshot_section(s);
+}
+
+// a species as structure-of-arrays
+struct packed_drones
+{
+    drone_store st;
+    std::vector<std::uint8_t> asleep;
+    std::vector<std::uint16_t> stay_awake;
+    // codes of x and y over frame, when saved quantized
+    std::vector<std::int16_t> qx;
+    std::vector<std::int16_t> qy;
+    yhl_util::quantizer<float> frame;
+};
+
+// codes of the drones' positions over their bounding box
+void
+quantize(packed_drones& p)
+{
+    auto const& st = p.st;
+    p.qx.clear();
+    p.qy.clear();
+    if (st.size() == 0) {
+        return;
+    }
+    auto [x0, x1] = std::minmax_element(st.x.begin(), st.x.end());
+    auto [y0, y1] = std::minmax_element(st.y.begin(), st.y.end());
+    p.frame =
+      yhl_util::quantizer<float>::covering(*x0, *y0, *x1 - *x0, *y1 - *y0);
+    for (std::size_t i = 0; i < st.size(); i++) {
+        p.qx.emplace_back(p.frame.encode_x(st.x[i]));
+        p.qy.emplace_back(p.frame.encode_y(st.y[i]));
+    }
+}
+
+/*
+the drones as structure-of-arrays, kept alive in stores until the writer
+is done with them
+*/
+void
+add_swarm(snapshot_writer& w,
+          const drone_manager& dm,
+          std::array<packed_drones, species_count>& stores,
+          bool quantized)
+{
+    for (auto s : all_species) {
+        auto& p = stores[std::size_t(s)];
+        auto& [st, asleep, stay_awake, qx, qy, frame] = p;
+        auto const& ds = dm.drones(s);
+        st.pack(ds.values());
+        asleep.clear();
+        stay_awake.clear();
+        for (auto const& d : ds.values()) {
+            asleep.emplace_back(d.asleep);
+            stay_awake.emplace_back(d.stay_awake);
+        }
+        auto sec = section_of(s);
+        if (quantized) {
+            quantize(p);
+            w.add<std::int16_t>(sec, drone_field::qx, qx);
+            w.add<std::int16_t>(sec, drone_field::qy, qy);
+            w.add<yhl_util::quantizer<float>>(
+              sec, drone_field::frame, { &frame, 1 });
+        } else {
+            w.add<float>(sec, drone_field::x, st.x);
+            w.add<float>(sec, drone_field::y, st.y);
+        }
+        w.add<float>(sec, drone_field::vx, st.vx);
+        w.add<float>(sec, drone_field::vy, st.vy);
+        w.add<float>(sec, drone_field::mass, st.mass);
+        w.add<int>(sec, drone_field::health, st.health);
+        w.add<std::uint8_t>(sec, drone_field::asleep, asleep);
+        w.add<std::uint16_t>(sec, drone_field::stay_awake, stay_awake);
+    }
+}
+
+void
+add_pool(snapshot_writer& w, snapshot_section sec, const particle_pool& p)
+{
+    auto n = p.size();
+    w.add<Vector2>(sec, particle_field::pos, { p.pos.data(), n });
+    w.add<Vector2>(sec, particle_field::vel, { p.vel.data(), n });
+    w.add<std::uint32_t>(sec, particle_field::age, { p.age.data(), n });
+    w.add<std::uint32_t>(
+      sec, particle_field::lifetime, { p.lifetime.data(), n });
+}
+
+void
+load_pool(const snapshot& snap, snapshot_section sec, particle_pool& p)
+{
+    auto pos = snap.array<Vector2>(sec, particle_field::pos);
+    auto vel = snap.array<Vector2>(sec, particle_field::vel);
+    auto age = snap.array<std::uint32_t>(sec, particle_field::age);
+    auto life = snap.array<std::uint32_t>(sec, particle_field::lifetime);
+    auto n = pos.size();
+    if (vel.size() != n || age.size() != n || life.size() != n) {
+        throw std::runtime_error("snapshot particle arrays disagree");
+    }
+    if (n > p.capacity()) {
+        throw std::runtime_error("snapshot has more particles than the pool");
+    }
+    std::copy(pos.begin(), pos.end(), p.pos.begin());
+    std::copy(vel.begin(), vel.end(), p.vel.begin());
+    std::copy(age.begin(), age.end(), p.age.begin());
+    std::copy(life.begin(), life.end(), p.lifetime.begin());
+    p.resize(n);
+}
+
+// the single element of a game field, or fallback if it's missing
+template<typename T>
+T
+scalar(const snapshot& snap, game_field f, T fallback)
+{
+    auto a = snap.array<T>(snapshot_section::game, f);
+    return a.size() == 1 ? a[0] : fallback;
+}
+};
+
+snapshot::snapshot(const std::string& path)
+{
+    require_little_endian();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("can't open snapshot " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        std::size_t(st.st_size) < sizeof(file_header)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is not a snapshot");
+    }
+    length = std::size_t(st.st_size);
+    void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file, the descriptor isn't needed
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("can't map snapshot " + path);
+    }
+    base = static_cast<const unsigned char*>(p);
+
+    file_header header;
+    std::memcpy(&header, base, sizeof(header));
+    auto fail = [&](const std::string& why) {
+        ::munmap(const_cast<unsigned char*>(base), length);
+        throw std::runtime_error(path + ": " + why);
+    };
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        fail("not a snapshot");
+    }
+    if (header.version != current_version) {
+        fail("unsupported snapshot version");
+    }
+    arrays = header.arrays;
+    saved_tick = header.tick;
+    if ((length - sizeof(header)) / sizeof(table_entry) < arrays) {
+        fail("truncated snapshot table");
+    }
+    // checked once here, so find() can hand out the arrays as they are
+    for (std::uint32_t i = 0; i < arrays; i++) {
+        table_entry e;
+        std::memcpy(&e, base + sizeof(header) + i * sizeof(e), sizeof(e));
+        if (e.offset % alignment != 0 || e.offset > length ||
+            e.element_size == 0 ||
+            e.count > (length - e.offset) / e.element_size) {
+            fail("snapshot array out of bounds");
+        }
+    }
+}
+
+snapshot::~snapshot()
+{
+    ::munmap(const_cast<unsigned char*>(base), length);
+}
+
+const void*
+snapshot::find(snapshot_section s,
+               std::uint32_t field,
+               std::size_t element_size,
+               std::size_t& count) const
+{
+    for (std::uint32_t i = 0; i < arrays; i++) {
+        table_entry e;
+        std::memcpy(
+          &e, base + sizeof(file_header) + i * sizeof(e), sizeof(e));
+        if (e.section != std::uint32_t(s) || e.field != field) {
+            continue;
+        }
+        if (e.element_size != element_size) {
+            throw std::runtime_error("snapshot array has the wrong type");
+        }
+        count = std::size_t(e.count);
+        return base + e.offset;
+    }
+    count = 0;
+    return nullptr;
+}
+
+void
+save_snapshot(const std::string& path,
+              const drone_manager& dm,
+              std::uint64_t tick,
+              bool quantized)
+{
+    snapshot_writer w;
+    std::array<packed_drones, species_count> stores;
+    add_swarm(w, dm, stores, quantized);
+    w.write(path, tick);
+}
+
+void
+save_snapshot(const std::string& path, const game& g, bool quantized)
+{
+    snapshot_writer w;
+    std::array<packed_drones, species_count> stores;
+    add_swarm(w, g.dm, stores, quantized);
+    add_pool(w, snapshot_section::bullets, g.bullets);
+    add_pool(w, snapshot_section::explosions, g.explosions);
+
+    std::array<float, 2> xs{ g.s.x, g.y.x };
+    std::array<float, 2> ys{ g.s.y, g.y.y };
+    std::array<double, 2> angles{ g.s.angle.angle(), g.y.angle.angle() };
+    w.add<float>(snapshot_section::ships, ship_field::x, xs);
+    w.add<float>(snapshot_section::ships, ship_field::y, ys);
+    w.add<double>(snapshot_section::ships, ship_field::angle, angles);
+
+    std::uint8_t debug = g.debug;
+    std::int32_t mount = -1;
+    if (g.t.attachment_point) {
+        mount = std::int32_t(*g.t.attachment_point -
+                             g.s.mounting_points.begin());
+    }
+    auto sec = snapshot_section::game;
+    w.add<std::uint64_t>(sec, game_field::next_fire, { &g.next_fire, 1 });
+    w.add<float>(sec, game_field::zoom, { &g.camera.zoom, 1 });
+    w.add<std::uint8_t>(sec, game_field::debug, { &debug, 1 });
+    w.add<std::int32_t>(sec, game_field::mount, { &mount, 1 });
+    w.write(path, g.ticks);
+}
+
+void
+load_snapshot(const snapshot& snap, drone_manager& dm)
+{
+    for (auto s : all_species) {
+        auto sec = section_of(s);
+        auto x = snap.array<float>(sec, drone_field::x);
+        auto y = snap.array<float>(sec, drone_field::y);
+        auto vx = snap.array<float>(sec, drone_field::vx);
+        auto vy = snap.array<float>(sec, drone_field::vy);
+        auto mass = snap.array<float>(sec, drone_field::mass);
+        auto health = snap.array<int>(sec, drone_field::health);
+        // older snapshots have every drone awake
+        auto asleep = snap.array<std::uint8_t>(sec, drone_field::asleep);
+        auto stay_awake =
+          snap.array<std::uint16_t>(sec, drone_field::stay_awake);
+        auto qx = snap.array<std::int16_t>(sec, drone_field::qx);
+        auto qy = snap.array<std::int16_t>(sec, drone_field::qy);
+        auto frame =
+          snap.array<yhl_util::quantizer<float>>(sec, drone_field::frame);
+        bool quantized = x.empty() && !qx.empty();
+        auto n = quantized ? qx.size() : x.size();
+        bool lod = !asleep.empty() || !stay_awake.empty();
+        bool positions = quantized
+                           ? qy.size() == n && frame.size() == 1
+                           : y.size() == n;
+        if (!positions || vx.size() != n || vy.size() != n ||
+            mass.size() != n || health.size() != n ||
+            (lod && (asleep.size() != n || stay_awake.size() != n))) {
+            throw std::runtime_error("snapshot drone arrays disagree");
+        }
+        // sized once, then the columns are copied straight into the drones
+        auto& ds = dm.drones(s);
+        ds.reset(n);
+        drone* out = ds.begin();
+        if (quantized) {
+            auto const& q = frame[0];
+            for (std::size_t i = 0; i < n; i++) {
+                out[i].pos = { q.decode_x(qx[i]), q.decode_y(qy[i]) };
+            }
+        } else {
+            for (std::size_t i = 0; i < n; i++) {
+                out[i].pos = { x[i], y[i] };
+            }
+        }
+        for (std::size_t i = 0; i < n; i++) {
+            out[i].vel = { vx[i], vy[i] };
+            out[i].mass = mass[i];
+            out[i].health = health[i];
+        }
+        if (lod) {
+            for (std::size_t i = 0; i < n; i++) {
+                out[i].asleep = asleep[i] != 0;
+                out[i].stay_awake = stay_awake[i];
+            }
+        }
+        dm.index_for(s).invalidate();
+    }
+    // the reduced tier's stagger carries on where it was
+    dm.ticks = snap.tick();
+}
+
+void
+load_snapshot(const snapshot& snap, game& g)
+{
+    load_snapshot(snap, g.dm);
+    load_pool(snap, snapshot_section::bullets, g.bullets);
+    load_pool(snap, snapshot_section::explosions, g.explosions);
+
+    auto xs = snap.array<float>(snapshot_section::ships, ship_field::x);
+    auto ys = snap.array<float>(snapshot_section::ships, ship_field::y);
+    auto angles =
+      snap.array<double>(snapshot_section::ships, ship_field::angle);
+    ship* ships[] = { &g.s, &g.y };
+    for (std::size_t i = 0; i < 2 && i < xs.size(); i++) {
+        if (ys.size() != xs.size() || angles.size() != xs.size()) {
+            throw std::runtime_error("snapshot ship arrays disagree");
+        }
+        ships[i]->x = xs[i];
+        ships[i]->y = ys[i];
+        ships[i]->angle = Eigen::Rotation2Dd(angles[i]);
+    }
+
+    g.next_fire = scalar<std::uint64_t>(snap, game_field::next_fire, 0);
+    g.camera.zoom = scalar<float>(snap, game_field::zoom, 1.f);
+    g.camera.target = g.s.get_center();
+    g.debug = scalar<std::uint8_t>(snap, game_field::debug, 0) != 0;
+    auto mount = scalar<std::int32_t>(snap, game_field::mount, -1);
+    for (auto& m : g.s.mounting_points) {
+        m.attachment.reset();
+    }
+    g.t.attachment_point = std::nullopt;
+    if (mount >= 0 && std::size_t(mount) < g.s.mounting_points.size()) {
+        auto m = g.s.mounting_points.begin() + mount;
+        g.t.attachment_point = m;
+        m->attachment.emplace(g.t);
+    }
+    g.ticks = snap.tick();
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cmath>
+#include <iostream>
+
+/*
+minimal checks for the behavior tests: a failed GAME7_CHECK prints where it
+failed and the test carries on, test_result() is main's exit code
+*/
+namespace game7_test {
+
+inline int&
+failures()
+{
+    static int n = 0;
+    return n;
+}
+
+inline void
+fail(const char* what, const char* file, int line)
+{
+    std::cerr << file << ":" << line << ": check failed: " << what << "\n";
+    failures()++;
+}
+
+inline int
+test_result()
+{
+    if (failures() != 0) {
+        std::cerr << failures() << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}
+
+};
+
+#define GAME7_CHECK(cond)                                                      \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            game7_test::fail(#cond, __FILE__, __LINE__);                       \
+        }                                                                      \
+    } while (0)
+
+#define GAME7_CHECK_NEAR(a, b, tolerance)                                      \
+    GAME7_CHECK(std::abs(double(a) - double(b)) <= double(tolerance))
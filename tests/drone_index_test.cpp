@@ -0,0 +1,63 @@
+#include "check.h"
+#include "drone.h"
+#include "drone_index.h"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/*
+the quadtree's aggregates after drones are swap_removed, as drone_manager
+removes its dead, must be those of the drones left once refreshed. and a
+switch of broadphase leaves queries on the one built until the next build
+*/
+namespace {
+// total mass of the index, from a walk that takes the whole tree as one body
+float
+mass_of(const drone_index& index)
+{
+    float mass = 0;
+    index.qtree.approximate(
+      1e6,
+      1e6,
+      1e7,
+      1e3,
+      [](float, float) { return true; },
+      [&](float, float, float m) { mass += m; },
+      [](std::uint32_t) {});
+    return mass;
+}
+};
+
+int
+main()
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> at(0, 2000);
+    std::vector<drone> drones;
+    for (int i = 0; i < 3000; i++) {
+        drones.emplace_back(drone{ { at(rng), at(rng) }, { 0, 0 }, 1.f, 1 });
+    }
+    drone_index index(broadphase::quadtree, 100);
+    index.build(drones);
+    GAME7_CHECK_NEAR(mass_of(index), 3000, 1e-2);
+
+    for (int k = 0; k < 1000; k++) {
+        auto i = std::uint32_t(rng() % drones.size());
+        auto last = std::uint32_t(drones.size() - 1);
+        drones[i] = drones[last];
+        drones.pop_back();
+        index.swap_remove(i, last);
+    }
+    GAME7_CHECK(index.in_sync(drones.size()));
+    index.refresh(drones);
+    GAME7_CHECK(index.in_sync(drones.size()));
+    GAME7_CHECK_NEAR(mass_of(index), 2000, 1e-2);
+
+    index.kind = broadphase::grid;
+    GAME7_CHECK(index.query(0, 0, 2000, 2000).size() == drones.size());
+    GAME7_CHECK(index.query_beats_scan(2000, 2000, 1));
+    index.refresh(drones);
+    GAME7_CHECK(index.in_sync(drones.size()));
+    GAME7_CHECK(index.query(0, 0, 2000, 2000).size() == drones.size());
+    return game7_test::test_result();
+}
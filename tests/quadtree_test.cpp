@@ -0,0 +1,171 @@
+#include "check.h"
+#include "quadtree.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <raylib.h>
+#include <vector>
+
+/*
+a tree kept up to date with move() and swap_remove() must answer like one
+rebuilt over the same items: every element once, each query finding every
+element inside its area, and the same aggregates
+*/
+namespace {
+struct body
+{
+    Vector2 pos;
+    float mass{ 1 };
+};
+
+using tree = yhl_util::quadtree<body>;
+
+std::vector<std::uint32_t>
+inside(const std::vector<body>& items, float x, float y, float w, float h)
+{
+    std::vector<std::uint32_t> res;
+    for (std::uint32_t i = 0; i < items.size(); i++) {
+        auto p = items[i].pos;
+        if (p.x >= x && p.x <= x + w && p.y >= y && p.y <= y + h) {
+            res.emplace_back(i);
+        }
+    }
+    return res;
+}
+
+// what t finds of the elements inside the area
+std::vector<std::uint32_t>
+found(const tree& t,
+      const std::vector<body>& items,
+      float x,
+      float y,
+      float w,
+      float h)
+{
+    std::vector<std::uint32_t> res;
+    t.query(x, y, w, h, [&](std::uint32_t e) {
+        auto p = items[e].pos;
+        if (p.x >= x && p.x <= x + w && p.y >= y && p.y <= y + h) {
+            res.emplace_back(e);
+        }
+    });
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+// the whole tree as one body, seen from far away
+body
+aggregate(const tree& t)
+{
+    body total{ { 0, 0 }, 0 };
+    int bodies = 0;
+    t.approximate(
+      1e6,
+      1e6,
+      1e7,
+      1e3,
+      [](float, float) { return true; },
+      [&](float cx, float cy, float m) {
+          total = { { cx, cy }, m };
+          bodies++;
+      },
+      [&](std::uint32_t) { bodies++; });
+    GAME7_CHECK(bodies == 1);
+    return total;
+}
+
+void
+check_against_rebuild(const tree& t,
+                      const std::vector<body>& items,
+                      std::mt19937& rng)
+{
+    // every element exactly once
+    std::vector<int> seen(items.size(), 0);
+    bool in_range = true;
+    t.query(-1e5, -1e5, 2e5, 2e5, [&](std::uint32_t e) {
+        if (e < items.size()) {
+            seen[e]++;
+        } else {
+            in_range = false;
+        }
+    });
+    GAME7_CHECK(in_range);
+    GAME7_CHECK(std::all_of(
+      seen.begin(), seen.end(), [](int n) { return n == 1; }));
+
+    tree fresh(t.x, t.y, t.w, t.h);
+    fresh.rebuild(items);
+    std::uniform_real_distribution<float> at(-200, 1200);
+    for (int q = 0; q < 200; q++) {
+        float x = at(rng);
+        float y = at(rng);
+        auto expected = inside(items, x, y, 60, 60);
+        GAME7_CHECK(found(t, items, x, y, 60, 60) == expected);
+        GAME7_CHECK(found(fresh, items, x, y, 60, 60) == expected);
+    }
+
+    fresh.summarize(items);
+    auto a = aggregate(t);
+    auto b = aggregate(fresh);
+    GAME7_CHECK_NEAR(a.mass, b.mass, 1e-3);
+    GAME7_CHECK_NEAR(a.pos.x, b.pos.x, 1e-2);
+    GAME7_CHECK_NEAR(a.pos.y, b.pos.y, 1e-2);
+}
+};
+
+int
+main()
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> at(0, 1000);
+    std::vector<body> items(4000);
+    for (auto& b : items) {
+        b.pos = { at(rng), at(rng) };
+    }
+    tree t(0, 0, 1000, 1000);
+    t.rebuild(items);
+    t.summarize(items);
+    check_against_rebuild(t, items, rng);
+
+    // small steps mostly stay in their leaf, jumps cross the tree. drone_index
+    // rebuilds once a drone leaves the tree, so they all stay inside
+    std::normal_distribution<float> step(0, 3);
+    auto keep = [](float v) { return std::clamp(v, 0.f, 1000.f); };
+    for (int round = 0; round < 5; round++) {
+        for (std::uint32_t i = 0; i < items.size(); i++) {
+            auto& p = items[i].pos;
+            if (i % 17 == 0) {
+                p = { at(rng), at(rng) };
+            } else {
+                p = { keep(p.x + step(rng)), keep(p.y + step(rng)) };
+            }
+            t.move(i, p.x, p.y);
+        }
+        t.summarize(items);
+        check_against_rebuild(t, items, rng);
+    }
+
+    // removing most of the drones merges the quads back up
+    while (items.size() > 20) {
+        auto i = std::uint32_t(rng() % items.size());
+        auto last = std::uint32_t(items.size() - 1);
+        items[i] = items[last];
+        items.pop_back();
+        t.swap_remove(i, last);
+        if (items.size() % 500 == 0) {
+            t.summarize(items);
+            check_against_rebuild(t, items, rng);
+        }
+    }
+    t.summarize(items);
+    check_against_rebuild(t, items, rng);
+
+    // and filling it up again splits them
+    for (int i = 0; i < 2000; i++) {
+        items.emplace_back(body{ { at(rng), at(rng) } });
+    }
+    t.rebuild(items);
+    t.summarize(items);
+    check_against_rebuild(t, items, rng);
+    return game7_test::test_result();
+}
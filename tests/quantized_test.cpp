@@ -0,0 +1,44 @@
+#include "check.h"
+#include "quantized.h"
+#include <cmath>
+#include <cstdint>
+
+/*
+codes round trip to within a step, clamp outside the area, keep comparisons
+with step boundaries exact, and stay defined for an area of no width
+*/
+int
+main()
+{
+    using q = yhl_util::quantizer<float>;
+    auto area = q::covering(-100, 50, 2048, 1024);
+    GAME7_CHECK(area.step_x == 2048.f / 65536);
+    GAME7_CHECK(area.step_y == 1024.f / 65536);
+    for (float v = -100; v < 1948; v += 7.3f) {
+        auto back = area.decode_x(area.encode_x(v));
+        GAME7_CHECK(back >= v && back - v <= area.step_x);
+    }
+
+    // outside the area clamps to its edges
+    GAME7_CHECK(area.encode_x(-1e6f) == -32768);
+    GAME7_CHECK(area.encode_x(1e6f) == 32767);
+    GAME7_CHECK(area.encode_y(NAN) == -32768);
+
+    // rounding up keeps x <= b exact for a step boundary b
+    float b = -100 + 1000 * area.step_x;
+    GAME7_CHECK(area.encode_x(std::nextafter(b, 1e9f)) > area.encode_x(b));
+    GAME7_CHECK(area.encode_x(std::nextafter(b, -1e9f)) <= area.encode_x(b));
+
+    // a single point, and a line, still get steps
+    auto point = q::covering(3, 4, 0, 0);
+    GAME7_CHECK(point.step_x > 0 && point.step_y > 0);
+    GAME7_CHECK(point.encode_x(3) == -32768);
+    GAME7_CHECK(point.decode_x(point.encode_x(3)) == 3);
+    GAME7_CHECK(point.decode_y(point.encode_y(4)) == 4);
+    auto line = q::covering(3, 4, 0, 500);
+    GAME7_CHECK(line.step_x > 0);
+    GAME7_CHECK(line.decode_x(line.encode_x(3)) == 3);
+    GAME7_CHECK_NEAR(
+      line.decode_y(line.encode_y(321.5f)), 321.5f, 500.f / 65536);
+    return game7_test::test_result();
+}
@@ -0,0 +1,65 @@
+#include "check.h"
+#include "drone_kernels.h"
+#include "replay.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/*
+a log keeps the simd level and broadphase it was recorded with, and a replay
+set up from it ends on the checksum of the recorded run, whatever level the
+host would have picked
+*/
+namespace {
+tick_input
+input_at(int i)
+{
+    tick_input in;
+    in.mouse = { 600.f + i, 300.f + (i % 20) * 10 };
+    if (i > 5) {
+        in.buttons = tick_input::left_down;
+    }
+    return in;
+}
+};
+
+int
+main()
+{
+    auto path = std::string(P_tmpdir) + "/game7_replay_test.g7r";
+    auto best = detect_simd_level();
+
+    replay_header h;
+    h.seed = 7;
+    h.drones = 300;
+    h.simd = simd_level::scalar;
+    h.index = broadphase::quadtree;
+    std::uint64_t recorded;
+    {
+        replay_writer w(path, h);
+        game g{ h.seed, int(h.drones), 1 };
+        GAME7_CHECK(use_recorded_setup(h, g));
+        for (int i = 0; i < 60; i++) {
+            w.record(input_at(i));
+            g.step(input_at(i));
+        }
+        recorded = g.checksum();
+    }
+
+    // the host's own choice, which the replay must not keep
+    set_simd_level(best);
+    replay_reader r(path);
+    GAME7_CHECK(r.header().simd == simd_level::scalar);
+    GAME7_CHECK(r.header().index == broadphase::quadtree);
+    game g{ r.header().seed, int(r.header().drones), 1 };
+    GAME7_CHECK(use_recorded_setup(r.header(), g));
+    GAME7_CHECK(active_simd_level() == simd_level::scalar);
+    tick_input in;
+    while (r.next(in)) {
+        g.step(in);
+    }
+    GAME7_CHECK(g.tick() == 60);
+    GAME7_CHECK(g.checksum() == recorded);
+    std::remove(path.c_str());
+    return game7_test::test_result();
+}
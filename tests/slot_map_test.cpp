@@ -0,0 +1,121 @@
+#include "check.h"
+#include "slot_map.h"
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/*
+handles keep naming their value while others are erased around it, and go
+stale once it is erased, even after its slot is reused, or the map reset.
+a map never hands out more slots than a handle's index bits can name
+*/
+int
+main()
+{
+    using yhl_util::slot_handle;
+    yhl_util::slot_map<int> m;
+    std::vector<slot_handle> h;
+    for (int i = 0; i < 8; i++) {
+        h.emplace_back(m.insert(i));
+    }
+
+    // erasing swaps the last value into the hole
+    m.erase(h[2]);
+    GAME7_CHECK(m.size() == 7);
+    GAME7_CHECK(!m.contains(h[2]));
+    GAME7_CHECK(m.get(h[2]) == nullptr);
+    GAME7_CHECK(m[2] == 7);
+    GAME7_CHECK(m.handle_at(2) == h[7]);
+    for (int i = 0; i < 8; i++) {
+        if (i != 2) {
+            GAME7_CHECK(m.get(h[i]) && *m.get(h[i]) == i);
+        }
+    }
+
+    // the freed slot is reused a generation later
+    auto reused = m.insert(100);
+    GAME7_CHECK(reused.index() == h[2].index());
+    GAME7_CHECK(reused.generation() != h[2].generation());
+    GAME7_CHECK(!m.contains(h[2]));
+    GAME7_CHECK(m.get(reused) && *m.get(reused) == 100);
+
+    // a stale handle erases nothing
+    m.erase(h[2]);
+    GAME7_CHECK(m.size() == 8);
+    GAME7_CHECK(m.contains(reused));
+
+    // erase_at by dense position, as the swarm removes its dead
+    m.erase_at(0);
+    GAME7_CHECK(!m.contains(h[0]));
+    GAME7_CHECK(m.get(reused) && *m.get(reused) == 100);
+    GAME7_CHECK(m.handle_at(0) == reused);
+
+    // reusing the same slot over and over never revives an old handle
+    auto first = m.insert(5);
+    auto slot = first.index();
+    std::vector<slot_handle> old{ first };
+    for (int i = 0; i < 50; i++) {
+        m.erase(old.back());
+        old.emplace_back(m.insert(i));
+        GAME7_CHECK(old.back().index() == slot);
+    }
+    for (std::size_t i = 0; i + 1 < old.size(); i++) {
+        GAME7_CHECK(!m.contains(old[i]));
+    }
+    GAME7_CHECK(m.contains(old.back()));
+
+    // clear stales every handle, and the slots come back
+    auto live = m.handle_at(0);
+    m.clear();
+    GAME7_CHECK(m.empty());
+    GAME7_CHECK(!m.contains(live));
+    GAME7_CHECK(!m.contains(old.back()));
+    auto again = m.insert(1);
+    GAME7_CHECK(m.contains(again));
+    GAME7_CHECK(!m.contains(live));
+
+    // reset hands out slots in order and stales everything before it, and
+    // slots past the new size stay free for inserts
+    auto before = m.handle_at(0);
+    m.reset(3);
+    GAME7_CHECK(m.size() == 3);
+    GAME7_CHECK(!m.contains(before));
+    for (std::size_t i = 0; i < 3; i++) {
+        GAME7_CHECK(m.handle_at(i).index() == i);
+        GAME7_CHECK(m[i] == 0);
+        m[i] = int(i) + 10;
+        GAME7_CHECK(*m.get(m.handle_at(i)) == int(i) + 10);
+    }
+    auto next = m.insert(20);
+    GAME7_CHECK(next.index() == 3);
+    GAME7_CHECK(m.get(next) && *m.get(next) == 20);
+    m.erase(m.handle_at(1));
+    GAME7_CHECK(m.size() == 3 && m[1] == 20);
+
+    // filled up, the last handle still names its value and the next insert
+    // throws instead of spilling into the generation bits
+    yhl_util::slot_map<std::uint8_t> full;
+    auto max = yhl_util::slot_map<std::uint8_t>::max_size;
+    full.reserve(max);
+    for (std::size_t i = 0; i < max; i++) {
+        full.insert(std::uint8_t(i));
+    }
+    auto top = full.handle_at(max - 1);
+    GAME7_CHECK(top.index() == max - 1);
+    GAME7_CHECK(top.generation() == 0);
+    GAME7_CHECK(full.get(top) && *full.get(top) == std::uint8_t(max - 1));
+    bool threw = false;
+    try {
+        full.insert(0);
+    } catch (const std::length_error&) {
+        threw = true;
+    }
+    GAME7_CHECK(threw);
+    GAME7_CHECK(full.size() == max);
+    // a freed slot can be had again
+    full.erase(top);
+    auto back = full.insert(7);
+    GAME7_CHECK(back.index() == max - 1);
+    GAME7_CHECK(full.get(back) && *full.get(back) == 7);
+    return game7_test::test_result();
+}
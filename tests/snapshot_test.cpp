@@ -0,0 +1,109 @@
+#include "check.h"
+#include "drone_manager.h"
+#include "snapshot.h"
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+
+/*
+a swarm saved and loaded back is the swarm that was saved, field for field
+and in the same order. saved quantized, its positions are off by at most a
+step of the species' bounding box, even when that box is a single point or
+a line
+*/
+namespace {
+std::string
+temp_path(const char* name)
+{
+    return std::string(P_tmpdir) + "/game7_" + name + ".g7s";
+}
+
+// tolerance is how far apart the positions may be, per species
+void
+check_same(const drone_manager& a,
+           const drone_manager& b,
+           std::array<float, species_count> tolerance = {})
+{
+    for (auto s : { species::green, species::red, species::yellow }) {
+        auto const& x = a.drones(s);
+        auto const& y = b.drones(s);
+        auto off = tolerance[std::size_t(s)];
+        GAME7_CHECK(x.size() == y.size());
+        for (std::size_t i = 0; i < x.size() && i < y.size(); i++) {
+            GAME7_CHECK_NEAR(x[i].pos.x, y[i].pos.x, off);
+            GAME7_CHECK_NEAR(x[i].pos.y, y[i].pos.y, off);
+            GAME7_CHECK(x[i].vel.x == y[i].vel.x && x[i].vel.y == y[i].vel.y);
+            GAME7_CHECK(x[i].mass == y[i].mass);
+            GAME7_CHECK(x[i].health == y[i].health);
+            GAME7_CHECK(x[i].asleep == y[i].asleep);
+            GAME7_CHECK(x[i].stay_awake == y[i].stay_awake);
+        }
+    }
+}
+};
+
+int
+main()
+{
+    std::mt19937 gen(3);
+    drone_manager dm{ 500, gen, 1 };
+    dm.use_lod(sim_lod{});
+    for (int i = 0; i < 5; i++) {
+        dm.tick({ 0, 0 });
+    }
+    dm.drones(species::green)[0].health = 0;
+    auto path = temp_path("snapshot_test");
+    save_snapshot(path, dm, 5);
+
+    std::mt19937 other(4);
+    drone_manager loaded{ 10, other, 1 };
+    loaded.use_lod(sim_lod{});
+    {
+        snapshot snap(path);
+        GAME7_CHECK(snap.tick() == 5);
+        load_snapshot(snap, loaded);
+    }
+    check_same(dm, loaded);
+
+    // a grid run carries on as if it never stopped
+    dm.tick({ 0, 0 });
+    loaded.tick({ 0, 0 });
+    check_same(dm, loaded);
+
+    // quantized, with a single red and yellows all on one vertical line
+    auto& reds = dm.drones(species::red);
+    while (reds.size() > 1) {
+        reds.erase_at(reds.size() - 1);
+    }
+    for (auto& d : dm.drones(species::yellow)) {
+        d.pos.x = 12.5f;
+    }
+    save_snapshot(path, dm, 6, true);
+    {
+        snapshot snap(path);
+        GAME7_CHECK(snap.array<float>(snapshot_section::green, drone_field::x)
+                      .empty());
+        load_snapshot(snap, loaded);
+    }
+    std::array<float, species_count> steps;
+    for (auto s : { species::green, species::red, species::yellow }) {
+        float lo = INFINITY;
+        float hi = -INFINITY;
+        for (auto const& d : dm.drones(s)) {
+            lo = std::min({ lo, d.pos.x, d.pos.y });
+            hi = std::max({ hi, d.pos.x, d.pos.y });
+        }
+        steps[std::size_t(s)] = std::max(hi - lo, 1.f) / 65536 * 1.01f;
+    }
+    check_same(dm, loaded, steps);
+    auto const& red = loaded.drones(species::red);
+    GAME7_CHECK(red.size() == 1);
+    GAME7_CHECK(std::isfinite(red[0].pos.x) && std::isfinite(red[0].pos.y));
+    for (auto const& d : loaded.drones(species::yellow)) {
+        GAME7_CHECK(d.pos.x == 12.5f);
+    }
+    std::remove(path.c_str());
+    return game7_test::test_result();
+}
@@ -0,0 +1,62 @@
+#include "check.h"
+#include "util.h"
+#include <raylib.h>
+
+/*
+edge cases of the swept point against circle test bullets use: starting
+inside, standing still, moving away, grazing, and hits just at or past the
+end of the step
+*/
+namespace {
+bool
+sweep(Vector2 from, Vector2 to, Vector2 center, float radius, float& t)
+{
+    t = -1;
+    return yhl_util::sweep_circle(
+      from, to, center, radius, yhl_util::out<float>(t));
+}
+};
+
+int
+main()
+{
+    float t;
+    Vector2 c{ 10, 0 };
+
+    // head on, entering the circle at x = 8
+    GAME7_CHECK(sweep({ 0, 0 }, { 20, 0 }, c, 2, t));
+    GAME7_CHECK_NEAR(t, 0.4, 1e-6);
+
+    // already inside, or on the edge, hits at the start
+    GAME7_CHECK(sweep({ 9, 0 }, { 30, 0 }, c, 2, t));
+    GAME7_CHECK(t == 0);
+    GAME7_CHECK(sweep({ 8, 0 }, { 0, 0 }, c, 2, t));
+    GAME7_CHECK(t == 0);
+
+    // standing still outside, or moving away
+    GAME7_CHECK(!sweep({ 0, 0 }, { 0, 0 }, c, 2, t));
+    GAME7_CHECK(!sweep({ 0, 0 }, { -20, 0 }, c, 2, t));
+    GAME7_CHECK(t == -1);
+
+    // stopping short of the circle, and reaching it on the last step
+    GAME7_CHECK(!sweep({ 0, 0 }, { 7.9f, 0 }, c, 2, t));
+    GAME7_CHECK(sweep({ 0, 0 }, { 8, 0 }, c, 2, t));
+    GAME7_CHECK_NEAR(t, 1, 1e-6);
+
+    // passing by, grazing the edge and cutting through off center
+    GAME7_CHECK(!sweep({ 0, 3 }, { 20, 3 }, c, 2, t));
+    GAME7_CHECK(sweep({ 0, 2 }, { 20, 2 }, c, 2, t));
+    GAME7_CHECK_NEAR(t, 0.5, 1e-3);
+    GAME7_CHECK(sweep({ 0, 1 }, { 20, 1 }, c, 2, t));
+    GAME7_CHECK(t > 0.4 && t < 0.5);
+
+    // a step straight across the whole circle still hits
+    GAME7_CHECK(sweep({ 0, 0 }, { 1000, 0 }, c, 2, t));
+    GAME7_CHECK_NEAR(t, 0.008, 1e-6);
+
+    // a zero radius circle is hit only by a path through its center
+    GAME7_CHECK(sweep({ 0, 0 }, { 20, 0 }, c, 0, t));
+    GAME7_CHECK_NEAR(t, 0.5, 1e-6);
+    GAME7_CHECK(!sweep({ 0, 0.5f }, { 20, 0.5f }, c, 0, t));
+    return game7_test::test_result();
+}
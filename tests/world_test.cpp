@@ -0,0 +1,159 @@
+#include "check.h"
+#include "drone_manager.h"
+#include "world.h"
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/*
+a chunk streamed out and back in, packed in memory or written to a file,
+holds the drones it was given, bit for bit. the codec sorts them, so they
+are compared as sets
+*/
+namespace {
+auto
+bits(const drone& d)
+{
+    return std::tuple{ std::bit_cast<std::uint32_t>(d.pos.x),
+                       std::bit_cast<std::uint32_t>(d.pos.y),
+                       std::bit_cast<std::uint32_t>(d.vel.x),
+                       std::bit_cast<std::uint32_t>(d.vel.y),
+                       std::bit_cast<std::uint32_t>(d.mass),
+                       d.health,
+                       d.asleep,
+                       d.stay_awake };
+}
+
+using drone_bits = std::vector<decltype(bits(drone{}))>;
+
+drone_bits
+sorted(const std::vector<drone>& ds)
+{
+    drone_bits res;
+    for (auto const& d : ds) {
+        res.emplace_back(bits(d));
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+drone_bits
+sorted(const yhl_util::slot_map<drone>& ds)
+{
+    return sorted(ds.values());
+}
+
+// drones all over chunk (0, 0) with awkward values in every field
+chunk_drones
+awkward_chunk(float side)
+{
+    std::mt19937 gen(9);
+    std::uniform_real_distribution<float> at(0, side);
+    std::uniform_real_distribution<float> vel(-10, 10);
+    chunk_drones drones;
+    for (std::size_t s = 0; s < species_count; s++) {
+        for (int i = 0; i < 700; i++) {
+            drone d{ { at(gen), at(gen) }, { vel(gen), vel(gen) }, 1.f, 1 };
+            if (i % 7 == 0) {
+                // several drones on the same x, and the chunk's corner
+                d.pos.x = 0;
+            }
+            if (i % 11 == 0) {
+                d.mass = 150.f;
+                d.health = -3;
+            }
+            if (i % 13 == 0) {
+                d.vel = { -0.f, 0.f };
+                d.asleep = true;
+                d.stay_awake = std::uint16_t(65535 - i);
+            }
+            drones[s].emplace_back(d);
+        }
+    }
+    return drones;
+}
+
+void
+empty_swarm(drone_manager& dm)
+{
+    for (auto s : { species::green, species::red, species::yellow }) {
+        dm.drones(s).clear();
+        dm.index_for(s).invalidate();
+    }
+}
+
+// move the player to pos and wait for the streaming to settle
+void
+go(world& w, Vector2 pos)
+{
+    w.stream(pos);
+    w.flush();
+    w.stream(pos);
+}
+
+void
+check_holds(const drone_manager& dm, const chunk_drones& expected)
+{
+    for (auto s : { species::green, species::red, species::yellow }) {
+        GAME7_CHECK(sorted(dm.drones(s)) ==
+                    sorted(expected[std::size_t(s)]));
+    }
+}
+
+void
+round_trip(const std::string& directory)
+{
+    std::mt19937 gen(1);
+    drone_manager dm{ 0, gen, 1 };
+    empty_swarm(dm);
+    world_settings settings;
+    settings.directory = directory;
+    auto expected = awkward_chunk(settings.chunk_size);
+    Vector2 home{ 100, 100 };
+    Vector2 away{ 100 * settings.chunk_size, 100 };
+    {
+        world w(dm, settings);
+        w.seed({ 0, 0 }, expected);
+        GAME7_CHECK(w.stats().stored_drones == 3 * 700);
+
+        // read back as seeded
+        go(w, home);
+        check_holds(dm, expected);
+        GAME7_CHECK(w.stats().stored_chunks == 0);
+
+        // packed from the swarm and read back again
+        go(w, away);
+        GAME7_CHECK(dm.drones(species::green).empty());
+        GAME7_CHECK(w.stats().stored_drones == 3 * 700);
+        go(w, home);
+        check_holds(dm, expected);
+        if (!directory.empty()) {
+            go(w, away);
+        }
+    }
+    if (directory.empty()) {
+        return;
+    }
+    // a new world finds the chunk where the last one left it
+    empty_swarm(dm);
+    world w(dm, settings);
+    GAME7_CHECK(w.stats().stored_chunks == 1);
+    go(w, home);
+    check_holds(dm, expected);
+}
+};
+
+int
+main()
+{
+    round_trip("");
+    auto dir = std::filesystem::temp_directory_path() / "game7_world_test";
+    std::filesystem::remove_all(dir);
+    round_trip(dir.string());
+    std::filesystem::remove_all(dir);
+    return game7_test::test_result();
+}
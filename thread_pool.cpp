@@ -0,0 +1,78 @@
+#include "thread_pool.h"
+
+thread_pool::thread_pool(unsigned threads)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back([this] { worker_loop(); });
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard lock(m);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+void
+thread_pool::run(std::size_t n, std::size_t grain, chunk_fn fn, void* ctx)
+{
+    if (workers.empty() || n <= grain) {
+        if (n > 0) {
+            fn(ctx, 0, n);
+        }
+        return;
+    }
+    {
+        std::lock_guard lock(m);
+        job_fn = fn;
+        job_ctx = ctx;
+        job_n = n;
+        job_grain = grain;
+        next = 0;
+        pending = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    work();
+    std::unique_lock lock(m);
+    done.wait(lock, [this] { return pending == 0; });
+}
+
+void
+thread_pool::work()
+{
+    for (auto begin = next.fetch_add(job_grain); begin < job_n;
+         begin = next.fetch_add(job_grain)) {
+        job_fn(job_ctx, begin, std::min(begin + job_grain, job_n));
+    }
+}
+
+void
+thread_pool::worker_loop()
+{
+    std::uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock lock(m);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        work();
+        std::lock_guard lock(m);
+        if (--pending == 0) {
+            done.notify_one();
+        }
+    }
+}
@@ -1,22 +1,41 @@
 #include "include/util.h"
+#include <cmath>
 #include <cstdint>
 
 namespace yhl_util {
 
 bool
-check_collision(const Rectangle& rect1, const Rectangle& rect2)
+sweep_circle(::Vector2 from,
+             ::Vector2 to,
+             ::Vector2 center,
+             float radius,
+             out<float> t)
 {
-    // Check if one rectangle is to the left of the other
-    if (rect1.x + rect1.width < rect2.x || rect2.x + rect2.width < rect1.x) {
-        return false; // No collision on the x-axis
+    // |from + t d - center|^2 = radius^2, solved for the smaller root
+    float dx = to.x - from.x;
+    float dy = to.y - from.y;
+    float fx = from.x - center.x;
+    float fy = from.y - center.y;
+    float c = fx * fx + fy * fy - radius * radius;
+    if (c <= 0) {
+        t = 0.f;
+        return true;
     }
-
-    // Check if one rectangle is above the other
-    if (rect1.y + rect1.height < rect2.y || rect2.y + rect2.height < rect1.y) {
-        return false; // No collision on the y-axis
+    float a = dx * dx + dy * dy;
+    float b = fx * dx + fy * dy;
+    // standing still outside, or moving away
+    if (a == 0 || b >= 0) {
+        return false;
     }
-
-    // If neither condition is true, the rectangles overlap
+    float disc = b * b - a * c;
+    if (disc < 0) {
+        return false;
+    }
+    float hit = (-b - std::sqrt(disc)) / a;
+    if (hit > 1) {
+        return false;
+    }
+    t = hit;
     return true;
 }
 
@@ -0,0 +1,610 @@
+#include "world.h"
+#include "profiler.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+/*
+a packed chunk:
+
+    header  "G7CK", u32 version, i32 x, i32 y, u32 drones per species
+    fields  per species, per field of drone: u32 bytes, then the field
+
+every field of a species is its elements' bits, each as the zigzagged
+difference from the one before, varint coded, with every run of zero bytes
+collapsed to a zero and the run's length. the drones are sorted by x first,
+so x barely changes from one to the next, and the fields that don't change
+at all (mass, health, the lod state) shrink to a few bytes. all integers are
+little-endian
+*/
+constexpr char magic[4] = { 'G', '7', 'C', 'K' };
+constexpr std::uint32_t version = 1;
+constexpr std::size_t header_size = 16 + 4 * species_count;
+constexpr std::size_t field_count = 8;
+
+void
+put_u32(std::vector<std::uint8_t>& out, std::uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        out.emplace_back(std::uint8_t(v >> (8 * i)));
+    }
+}
+
+std::uint32_t
+get_u32(const std::uint8_t*& p, const std::uint8_t* end)
+{
+    if (end - p < 4) {
+        throw std::runtime_error("chunk truncated");
+    }
+    std::uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v |= std::uint32_t(*p++) << (8 * i);
+    }
+    return v;
+}
+
+void
+put_varint(std::vector<std::uint8_t>& out, std::uint32_t v)
+{
+    while (v >= 0x80) {
+        out.emplace_back(std::uint8_t(v | 0x80));
+        v >>= 7;
+    }
+    out.emplace_back(std::uint8_t(v));
+}
+
+// next_byte() yields the coded bytes in order
+template<typename F>
+std::uint32_t
+get_varint(F&& next_byte)
+{
+    std::uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        auto b = next_byte();
+        v |= std::uint32_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+    throw std::runtime_error("chunk varint too long");
+}
+
+std::uint32_t
+field_bits(const drone& d, std::size_t f)
+{
+    switch (f) {
+        case 0:
+            return std::bit_cast<std::uint32_t>(d.pos.x);
+        case 1:
+            return std::bit_cast<std::uint32_t>(d.pos.y);
+        case 2:
+            return std::bit_cast<std::uint32_t>(d.vel.x);
+        case 3:
+            return std::bit_cast<std::uint32_t>(d.vel.y);
+        case 4:
+            return std::bit_cast<std::uint32_t>(d.mass);
+        case 5:
+            return std::bit_cast<std::uint32_t>(d.health);
+        case 6:
+            return d.asleep;
+        default:
+            return d.stay_awake;
+    }
+}
+
+void
+set_field(drone& d, std::size_t f, std::uint32_t v)
+{
+    switch (f) {
+        case 0:
+            d.pos.x = std::bit_cast<float>(v);
+            break;
+        case 1:
+            d.pos.y = std::bit_cast<float>(v);
+            break;
+        case 2:
+            d.vel.x = std::bit_cast<float>(v);
+            break;
+        case 3:
+            d.vel.y = std::bit_cast<float>(v);
+            break;
+        case 4:
+            d.mass = std::bit_cast<float>(v);
+            break;
+        case 5:
+            d.health = std::bit_cast<int>(v);
+            break;
+        case 6:
+            d.asleep = v != 0;
+            break;
+        default:
+            d.stay_awake = std::uint16_t(v);
+    }
+}
+
+void
+put_field(std::vector<std::uint8_t>& out,
+          std::span<const drone> drones,
+          std::size_t f,
+          std::vector<std::uint8_t>& coded)
+{
+    coded.clear();
+    std::uint32_t prev = 0;
+    for (auto const& d : drones) {
+        auto v = field_bits(d, f);
+        auto delta = std::int32_t(v - prev);
+        put_varint(coded,
+                   (std::uint32_t(delta) << 1) ^ std::uint32_t(delta >> 31));
+        prev = v;
+    }
+    auto at = out.size();
+    put_u32(out, 0);
+    for (std::size_t i = 0; i < coded.size();) {
+        if (coded[i] != 0) {
+            out.emplace_back(coded[i++]);
+            continue;
+        }
+        auto run = i;
+        while (i < coded.size() && coded[i] == 0) {
+            i++;
+        }
+        out.emplace_back(0);
+        put_varint(out, std::uint32_t(i - run));
+    }
+    auto bytes = std::uint32_t(out.size() - at - 4);
+    for (int i = 0; i < 4; i++) {
+        out[at + i] = std::uint8_t(bytes >> (8 * i));
+    }
+}
+
+void
+get_field(const std::uint8_t*& p,
+          const std::uint8_t* end,
+          std::span<drone> drones,
+          std::size_t f)
+{
+    auto bytes = get_u32(p, end);
+    if (std::size_t(end - p) < bytes) {
+        throw std::runtime_error("chunk truncated");
+    }
+    const std::uint8_t* q = p;
+    const std::uint8_t* field_end = p + bytes;
+    p = field_end;
+    auto next = [&] {
+        if (q == field_end) {
+            throw std::runtime_error("chunk field truncated");
+        }
+        return *q++;
+    };
+    // zero bytes still owed from the current run
+    std::uint32_t zeros = 0;
+    auto next_byte = [&]() -> std::uint8_t {
+        if (zeros > 0) {
+            zeros--;
+            return 0;
+        }
+        auto b = next();
+        if (b == 0) {
+            zeros = get_varint(next);
+            if (zeros == 0) {
+                throw std::runtime_error("chunk has an empty zero run");
+            }
+            zeros--;
+        }
+        return b;
+    };
+    std::uint32_t prev = 0;
+    for (auto& d : drones) {
+        auto zz = get_varint(next_byte);
+        auto delta = (zz >> 1) ^ (0u - (zz & 1));
+        prev += delta;
+        set_field(d, f, prev);
+    }
+}
+
+std::vector<std::uint8_t>
+pack_chunk(chunk_key key, chunk_drones drones)
+{
+    std::vector<std::uint8_t> out;
+    for (auto c : magic) {
+        out.emplace_back(std::uint8_t(c));
+    }
+    put_u32(out, version);
+    put_u32(out, std::uint32_t(key.x));
+    put_u32(out, std::uint32_t(key.y));
+    for (auto const& ds : drones) {
+        put_u32(out, std::uint32_t(ds.size()));
+    }
+    std::vector<std::uint8_t> coded;
+    for (auto& ds : drones) {
+        std::sort(ds.begin(), ds.end(), [](const drone& a, const drone& b) {
+            return a.pos.x < b.pos.x ||
+                   (a.pos.x == b.pos.x && a.pos.y < b.pos.y);
+        });
+        for (std::size_t f = 0; f < field_count; f++) {
+            put_field(out, ds, f, coded);
+        }
+    }
+    return out;
+}
+
+// the drones per species from a header, after checking it is key's
+std::array<std::uint32_t, species_count>
+read_header(const std::uint8_t*& p, const std::uint8_t* end, chunk_key key)
+{
+    if (std::size_t(end - p) < header_size ||
+        std::memcmp(p, magic, 4) != 0) {
+        throw std::runtime_error("not a chunk");
+    }
+    p += 4;
+    if (get_u32(p, end) != version) {
+        throw std::runtime_error("unsupported chunk version");
+    }
+    auto x = std::int32_t(get_u32(p, end));
+    auto y = std::int32_t(get_u32(p, end));
+    if (chunk_key{ x, y } != key) {
+        throw std::runtime_error("chunk is somewhere else");
+    }
+    std::array<std::uint32_t, species_count> counts;
+    for (auto& n : counts) {
+        n = get_u32(p, end);
+    }
+    return counts;
+}
+
+chunk_drones
+unpack_chunk(chunk_key key, std::span<const std::uint8_t> blob)
+{
+    auto p = blob.data();
+    auto end = p + blob.size();
+    auto counts = read_header(p, end, key);
+    chunk_drones drones;
+    for (std::size_t s = 0; s < species_count; s++) {
+        drones[s].resize(counts[s], drone{ .health = 0 });
+        for (std::size_t f = 0; f < field_count; f++) {
+            get_field(p, end, drones[s], f);
+        }
+    }
+    return drones;
+}
+
+std::vector<std::uint8_t>
+read_file(const std::string& path)
+{
+    std::ifstream in{ path, std::ios::binary | std::ios::ate };
+    std::vector<std::uint8_t> bytes(in ? std::size_t(in.tellg()) : 0);
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(bytes.data()),
+                 std::streamsize(bytes.size()))) {
+        throw std::runtime_error("can't read chunk " + path);
+    }
+    return bytes;
+}
+
+void
+write_file(const std::string& path, const std::vector<std::uint8_t>& bytes)
+{
+    std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+    out.write(reinterpret_cast<const char*>(bytes.data()),
+              std::streamsize(bytes.size()));
+    if (!out.flush()) {
+        throw std::runtime_error("can't write chunk " + path);
+    }
+}
+
+std::size_t
+count(const chunk_drones& drones)
+{
+    std::size_t n = 0;
+    for (auto const& ds : drones) {
+        n += ds.size();
+    }
+    return n;
+}
+};
+
+world::world(drone_manager& dm, world_settings settings_)
+  : dm(dm)
+  , settings(std::move(settings_))
+{
+    settings.unload_radius =
+      std::max(settings.unload_radius, settings.load_radius + 1);
+    if (!settings.directory.empty()) {
+        namespace fs = std::filesystem;
+        fs::create_directories(settings.directory);
+        for (auto const& entry : fs::directory_iterator(settings.directory)) {
+            auto name = entry.path().filename().string();
+            chunk_key key;
+            char tail;
+            if (std::sscanf(
+                  name.c_str(), "chunk_%d_%d.g7%c", &key.x, &key.y, &tail) !=
+                  3 ||
+                path_of(key) != entry.path().string()) {
+                continue;
+            }
+            // only the header, the drones are read when they are needed
+            std::vector<std::uint8_t> header(header_size);
+            std::ifstream in{ entry.path(), std::ios::binary };
+            in.read(reinterpret_cast<char*>(header.data()), header_size);
+            const std::uint8_t* p = header.data();
+            auto counts = read_header(p, p + in.gcount(), key);
+            stored_chunk c;
+            c.bytes = std::size_t(entry.file_size());
+            for (auto n : counts) {
+                c.drones += n;
+            }
+            stored_drones += c.drones;
+            stored_bytes += c.bytes;
+            store.emplace(key, std::move(c));
+            out.insert(key);
+        }
+    }
+    worker = std::thread([this] { run(); });
+}
+
+template<typename F>
+void
+world::evict(F&& far)
+{
+    std::map<chunk_key, chunk_drones> leaving;
+    for (auto s : { species::green, species::red, species::yellow }) {
+        auto& ds = dm.drones(s);
+        auto& index = dm.index_for(s);
+        // back to front, like removing the dead
+        for (auto i = ds.size(); i-- > 0;) {
+            auto key = chunk_of(ds[i].pos);
+            if (far(key)) {
+                leaving[key][std::size_t(s)].emplace_back(ds[i]);
+                index.swap_remove(i, ds.size() - 1);
+                ds.erase_at(i);
+            }
+        }
+    }
+    for (auto& [key, drones] : leaving) {
+        stash(key, std::move(drones));
+    }
+}
+
+world::~world()
+{
+    try {
+        if (!settings.directory.empty()) {
+            // what is in flight back in, then everything out
+            flush();
+            std::vector<std::pair<chunk_key, chunk_drones>> arrived;
+            {
+                std::lock_guard lock{ jobs_lock };
+                std::swap(arrived, ready);
+            }
+            for (auto const& [key, drones] : arrived) {
+                merge(drones);
+            }
+            evict([](chunk_key) { return true; });
+        }
+        flush();
+    } catch (const std::exception& e) {
+        std::cerr << "can't store the world: " << e.what() << "\n";
+    }
+    {
+        std::lock_guard lock{ jobs_lock };
+        stopping = true;
+    }
+    jobs_changed.notify_all();
+    worker.join();
+    if (error) {
+        std::cerr << "can't store the world\n";
+    }
+}
+
+chunk_key
+world::chunk_of(Vector2 pos) const
+{
+    return { std::int32_t(std::floor(pos.x / settings.chunk_size)),
+             std::int32_t(std::floor(pos.y / settings.chunk_size)) };
+}
+
+Vector2
+world::origin(chunk_key key) const
+{
+    return { key.x * settings.chunk_size, key.y * settings.chunk_size };
+}
+
+std::string
+world::path_of(chunk_key key) const
+{
+    return (std::filesystem::path(settings.directory) /
+            ("chunk_" + std::to_string(key.x) + "_" + std::to_string(key.y) +
+             ".g7c"))
+      .string();
+}
+
+void
+world::seed(chunk_key key, const chunk_drones& drones)
+{
+    if (out.contains(key) || loading.contains(key)) {
+        throw std::runtime_error("chunk seeded twice");
+    }
+    put(key, pack_chunk(key, drones), count(drones));
+    out.insert(key);
+}
+
+void
+world::put(chunk_key key, std::vector<std::uint8_t>&& blob, std::size_t n)
+{
+    stored_chunk c;
+    c.drones = n;
+    c.bytes = blob.size();
+    if (!settings.directory.empty()) {
+        write_file(path_of(key), blob);
+    } else {
+        c.blob = std::move(blob);
+    }
+    std::lock_guard lock{ store_lock };
+    auto& slot = store[key];
+    stored_drones += c.drones - slot.drones;
+    stored_bytes += c.bytes - slot.bytes;
+    slot = std::move(c);
+}
+
+chunk_drones
+world::take(chunk_key key)
+{
+    stored_chunk c;
+    {
+        std::lock_guard lock{ store_lock };
+        auto it = store.find(key);
+        if (it == store.end()) {
+            return {};
+        }
+        c = std::move(it->second);
+        store.erase(it);
+        stored_drones -= c.drones;
+        stored_bytes -= c.bytes;
+    }
+    if (!settings.directory.empty()) {
+        auto path = path_of(key);
+        c.blob = read_file(path);
+        std::filesystem::remove(path);
+    }
+    return unpack_chunk(key, c.blob);
+}
+
+void
+world::run()
+{
+    for (;;) {
+        job j;
+        {
+            std::unique_lock lock{ jobs_lock };
+            // what is queued still runs after stopping
+            jobs_changed.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            j = std::move(jobs.front());
+            jobs.pop_front();
+            busy = true;
+        }
+        try {
+            GAME7_ZONE("world streaming");
+            auto drones = take(j.key);
+            if (j.load) {
+                std::lock_guard lock{ jobs_lock };
+                ready.emplace_back(j.key, std::move(drones));
+            } else {
+                for (std::size_t s = 0; s < species_count; s++) {
+                    drones[s].insert(
+                      drones[s].end(), j.drones[s].begin(), j.drones[s].end());
+                }
+                auto n = count(drones);
+                put(j.key, pack_chunk(j.key, std::move(drones)), n);
+            }
+        } catch (...) {
+            std::lock_guard lock{ jobs_lock };
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard lock{ jobs_lock };
+            busy = false;
+        }
+        jobs_changed.notify_all();
+    }
+}
+
+void
+world::flush()
+{
+    std::unique_lock lock{ jobs_lock };
+    jobs_changed.wait(lock, [&] { return jobs.empty() && !busy; });
+}
+
+void
+world::stash(chunk_key key, chunk_drones&& drones)
+{
+    out.insert(key);
+    streamed_out++;
+    {
+        std::lock_guard lock{ jobs_lock };
+        jobs.push_back({ false, key, std::move(drones) });
+    }
+    jobs_changed.notify_all();
+}
+
+void
+world::merge(const chunk_drones& drones)
+{
+    for (auto s : { species::green, species::red, species::yellow }) {
+        auto& ds = dm.drones(s);
+        for (auto const& d : drones[std::size_t(s)]) {
+            ds.insert(d);
+        }
+        dm.index_for(s).invalidate();
+    }
+}
+
+void
+world::stream(Vector2 player_pos)
+{
+    GAME7_ZONE("world stream");
+    std::vector<std::pair<chunk_key, chunk_drones>> arrived;
+    std::exception_ptr failed;
+    {
+        std::lock_guard lock{ jobs_lock };
+        std::swap(arrived, ready);
+        std::swap(failed, error);
+    }
+    for (auto const& [key, drones] : arrived) {
+        merge(drones);
+        loading.erase(key);
+        streamed_in++;
+    }
+    if (failed) {
+        std::rethrow_exception(failed);
+    }
+
+    auto center = chunk_of(player_pos);
+    auto distance = [&](chunk_key k) {
+        return std::max(std::abs(k.x - center.x), std::abs(k.y - center.y));
+    };
+    evict([&](chunk_key k) { return distance(k) > settings.unload_radius; });
+
+    int r = settings.load_radius;
+    for (int y = center.y - r; y <= center.y + r; y++) {
+        for (int x = center.x - r; x <= center.x + r; x++) {
+            chunk_key key{ x, y };
+            if (!out.contains(key) || loading.contains(key)) {
+                continue;
+            }
+            out.erase(key);
+            loading.insert(key);
+            {
+                std::lock_guard lock{ jobs_lock };
+                jobs.push_back({ true, key, {} });
+            }
+            jobs_changed.notify_all();
+        }
+    }
+}
+
+world_stats
+world::stats() const
+{
+    world_stats st;
+    {
+        std::lock_guard lock{ store_lock };
+        st.stored_chunks = store.size();
+        st.stored_drones = stored_drones;
+        st.stored_bytes = stored_bytes;
+    }
+    st.loading = loading.size();
+    st.streamed_in = streamed_in;
+    st.streamed_out = streamed_out;
+    return st;
+}